@@ -0,0 +1,86 @@
+/**
+ * @file bench_circbuf.c
+ * @brief microbenchmark of the circbuf interpolation kernels for each sample format
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "util/circbuf.h"
+
+
+#define BENCH_BUFFERSIZE 262144
+#define BENCH_SPANSIZE 256
+#define BENCH_SAMPLES (1 << 22)
+
+
+static const char *bench_names[CIRCBUF_INTERP_COUNT] = {"none", "linear", "hermite", "sinc"};
+static const char *bench_formats[CIRCBUF_FORMAT_COUNT] = {"float", "int16", "float16"};
+
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_run(circbuf *cb, circbuf_interp interp, double start, float speed) {
+    float dst[BENCH_SPANSIZE];
+    double position = start, t0, elapsed, sum = 0.0;
+    size_t i;
+
+    cb->interp = interp;
+
+    t0 = bench_now();
+    for (i = 0; i < BENCH_SAMPLES; i += BENCH_SPANSIZE) {
+        position = circbuf_read_span(cb, position, speed, dst, BENCH_SPANSIZE);
+        sum += dst[0];
+    }
+    elapsed = bench_now() - t0;
+
+    printf("%-8s %-8s speed: %5.3f  start: %-6g %8.3f ns/sample  (checksum %g)\n",
+        bench_formats[cb->format],
+        bench_names[interp],
+        speed,
+        start,
+        elapsed * 1e9 / BENCH_SAMPLES,
+        sum);
+}
+
+int main(void) {
+    static float noise[BENCH_BUFFERSIZE];
+    mem_arena *arena = mem_arena_new(sizeof(float) * BENCH_BUFFERSIZE * CIRCBUF_FORMAT_COUNT + 4096);
+    size_t i;
+
+    if (!arena) {
+        fprintf(stderr, "bench_circbuf: allocation failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < BENCH_BUFFERSIZE; i++) noise[i] = (float) rand() / RAND_MAX - 0.5f;
+
+    for (int format = 0; format < CIRCBUF_FORMAT_COUNT; format++) {
+        circbuf *cb = circbuf_new(arena, BENCH_BUFFERSIZE, 0, format);
+
+        if (!cb) {
+            fprintf(stderr, "bench_circbuf: allocation failed\n");
+            return 1;
+        }
+
+        circbuf_write_block(cb, noise, BENCH_BUFFERSIZE);
+
+        for (int interp = 0; interp < CIRCBUF_INTERP_COUNT; interp++) {
+            // unpitched grains at an integer and a fractional position, and a pitched grain
+            bench_run(cb, interp, 0.0, 1.0f);
+            bench_run(cb, interp, 0.25, 1.0f);
+            bench_run(cb, interp, 0.25, 1.4983f);
+        }
+
+        circbuf_free(cb);
+    }
+
+    mem_arena_free(arena);
+
+    return 0;
+}
@@ -0,0 +1,657 @@
+/**
+ * @file bench_suite.c
+ * @brief microbenchmarks of every hot kernel with machine-readable results
+ *
+ * Each kernel is measured over a sweep of representative parameters. The results are printed as a table,
+ * written as JSON with `-j` and compared against a saved JSON baseline with `-c`:
+ *
+ *     bench_suite [-j results.json] [-c baseline.json] [-t percent] [-f filter]
+ *
+ * Every benchmark is repeated @ref BENCH_REPEAT times and the median is reported. The number of samples per
+ * repetition is calibrated during a warm up, so that slow configurations do not dominate the run time. In compare mode a
+ * benchmark that got slower than the baseline by more than the threshold is flagged as a regression
+ * and the exit status is 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES 1
+#else
+#define BENCH_HAVE_CYCLES 0
+#endif
+
+#include "goat.h"
+#include "control/preset.h"
+#include "util/circbuf.h"
+#include "pitch/vocaldetector.h"
+#include "graintable/graintable.h"
+#include "evelopbuf/evelopbuf.h"
+#include "synthesizer/synthesizer.h"
+
+
+#define BENCH_SAMPLES (1 << 20) /**< maximum number of samples processed per repetition */
+#define BENCH_TIME 0.05 /**< seconds a repetition should take at most, heavy kernels process fewer samples */
+#define BENCH_REPEAT 5 /**< number of repetitions, the median is reported */
+#define BENCH_MAXRESULTS 256
+#define BENCH_BUFFERSIZE 262144
+
+
+/**
+ * @brief a single benchmark
+ *
+ * @ref bench_case.run processes @ref bench_case.n samples per call. The remaining fields are the state of the kernels.
+ */
+typedef struct bench_case {
+    void (*run)(struct bench_case *bc);
+    size_t n; /**< number of samples processed by a call of run */
+
+    circbuf *cb;
+    vocaldetector *vd;
+    control_manager *mgr;
+    goat *g;
+    graintable *gt;
+    synthesizer *syn;
+    evelopbuf *eb;
+    evelope *ep;
+    size_t offset;
+    unsigned int seed;
+    float speed;
+    int streaming;
+    int grainsize;
+    float *buf;
+    double sum; /**< keeps the results alive */
+} bench_case;
+
+typedef struct {
+    char name[48];
+    char params[80];
+    const char *unit;
+    double ns; /**< nanoseconds per unit */
+    double cycles; /**< reference cycles per unit or a negative number if not available */
+} bench_result;
+
+
+static bench_result bench_results[BENCH_MAXRESULTS];
+static int bench_numresults = 0;
+static const char *bench_filter = NULL;
+
+static const char *bench_formats[CIRCBUF_FORMAT_COUNT] = {"float", "int16", "float16"};
+static const char *bench_interps[CIRCBUF_INTERP_COUNT] = {"none", "linear", "hermite", "sinc"};
+
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long bench_cycles(void) {
+#if BENCH_HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int bench_compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void bench_noise(float *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = (float) rand() / RAND_MAX - 0.5f;
+}
+
+/**
+ * @brief measure a benchmark and store its median result
+ */
+static void bench_measure(const char *name, const char *params, const char *unit, bench_case *bc) {
+    double ns[BENCH_REPEAT], cycles[BENCH_REPEAT], t0, elapsed;
+    unsigned long long c0, celapsed;
+    size_t calls = BENCH_SAMPLES / bc->n + 1, i;
+    bench_result *r;
+    int rep;
+
+    if (bench_filter && !strstr(name, bench_filter)) return;
+    if (bench_numresults == BENCH_MAXRESULTS) {
+        fprintf(stderr, "bench_suite: too many benchmarks\n");
+        exit(1);
+    }
+
+    // warm up the caches and the branch predictors and find out how many calls fit into the time budget
+    t0 = bench_now();
+    for (i = 0; i < calls / 8 + 1 && (elapsed = bench_now() - t0) < BENCH_TIME / 4; i++) bc->run(bc);
+    if (elapsed >= BENCH_TIME / 4) calls = min(calls, (size_t) (i * BENCH_TIME / elapsed) + 1);
+
+    for (rep = 0; rep < BENCH_REPEAT; rep++) {
+        t0 = bench_now();
+        c0 = bench_cycles();
+        for (i = 0; i < calls; i++) bc->run(bc);
+        celapsed = bench_cycles() - c0;
+        elapsed = bench_now() - t0;
+
+        ns[rep] = elapsed * 1e9 / (calls * bc->n);
+        cycles[rep] = (double) celapsed / (calls * bc->n);
+    }
+
+    qsort(ns, BENCH_REPEAT, sizeof(double), bench_compare_double);
+    qsort(cycles, BENCH_REPEAT, sizeof(double), bench_compare_double);
+
+    r = &bench_results[bench_numresults++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->params, sizeof(r->params), "%s", params);
+    r->unit = unit;
+    r->ns = ns[BENCH_REPEAT / 2];
+    r->cycles = BENCH_HAVE_CYCLES ? cycles[BENCH_REPEAT / 2] : -1.0;
+
+    fprintf(stderr, "%-26s %-52s %10.3f ns/%-6s", r->name, r->params, r->ns, unit);
+    if (r->cycles >= 0.0) fprintf(stderr, " %10.2f cycles/%s", r->cycles, unit);
+    fprintf(stderr, "\n");
+}
+
+
+static void run_write_block(bench_case *bc) {
+    circbuf_write_block(bc->cb, bc->buf, bc->n);
+}
+
+static void run_read_block(bench_case *bc) {
+    circbuf_read_block(bc->cb, 0, bc->buf, bc->n);
+    bc->sum += bc->buf[0];
+
+    // stay clear of the write tap
+    if (bc->cb->readtaps[0].position > BENCH_BUFFERSIZE / 2) bc->cb->readtaps[0].position = 0.25f;
+}
+
+static void bench_circbuf(mem_arena *arena) {
+    static float block[4096];
+    size_t blocksizes[] = {64, 256, 1024};
+    float speeds[] = {1.0f, 1.4983f, 0.5f};
+    bench_case bc = {0};
+    char params[80];
+
+    bench_noise(block, 4096);
+
+    for (int format = 0; format < CIRCBUF_FORMAT_COUNT; format++) {
+        bc.cb = circbuf_new(arena, BENCH_BUFFERSIZE, 1, format);
+        bc.buf = block;
+        if (!bc.cb) exit(1);
+
+        for (size_t b = 0; b < sizeof(blocksizes) / sizeof(blocksizes[0]); b++) {
+            bc.run = run_write_block;
+            bc.n = blocksizes[b];
+            snprintf(params, sizeof(params), "format=%s n=%zu", bench_formats[format], bc.n);
+            bench_measure("circbuf_write_block", params, "sample", &bc);
+        }
+
+        for (int i = 0; i < BENCH_BUFFERSIZE / 4096; i++) circbuf_write_block(bc.cb, block, 4096);
+        bc.cb->writetap.position = BENCH_BUFFERSIZE - 1;
+
+        for (int interp = 0; interp < CIRCBUF_INTERP_COUNT; interp++) {
+            for (size_t s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+                bc.cb->interp = interp;
+                bc.cb->readtaps[0].position = 0.25f;
+                bc.cb->readtaps[0].speed = speeds[s];
+                bc.run = run_read_block;
+                bc.n = 64;
+                snprintf(params, sizeof(params), "format=%s interp=%s speed=%g n=64", bench_formats[format], bench_interps[interp], speeds[s]);
+                bench_measure("circbuf_read_block", params, "sample", &bc);
+            }
+        }
+
+        circbuf_free(bc.cb);
+    }
+}
+
+
+static void run_correlate(bench_case *bc) {
+    bc->sum += vd_bitstream_correlate(bc->vd, 0, bc->offset, bc->n);
+}
+
+static void run_vd_perform(bench_case *bc) {
+    // walk through a second of the signal, so that the detector sees a continuous tone
+    if (bc->offset + bc->n > 44100) bc->offset = 0;
+    vd_perform(bc->vd, &bc->buf[bc->offset], bc->n);
+    bc->offset += bc->n;
+}
+
+static void bench_vocaldetector(mem_arena *arena, size_t sample_rate) {
+    static float sine[44100];
+    size_t blocksizes[] = {64, 128, 256, 512};
+    size_t periods[] = {VD_PERIOD_MIN, VD_PERIOD_MAX};
+    bench_case bc = {0};
+    char params[80];
+    size_t i;
+
+    bc.vd = vd_new(arena, sample_rate);
+    if (!bc.vd) exit(1);
+
+    for (i = 0; i < 44100; i++) sine[i] = sinf(i * 2.0f * M_PI * 220.0f / sample_rate) + 0.1f * ((float) rand() / RAND_MAX - 0.5f);
+    for (i = 0; i + 512 <= 44100; i += 512) vd_perform(bc.vd, &sine[i], 512);
+
+    for (i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+        bc.run = run_correlate;
+        bc.n = periods[i];
+        bc.offset = periods[i] / 2 + 3;
+        snprintf(params, sizeof(params), "bits=%zu", bc.n);
+        bench_measure("vd_bitstream_correlate", params, "bit", &bc);
+    }
+
+    // a voiced signal, the slower path of the detector
+    for (i = 0; i < sizeof(blocksizes) / sizeof(blocksizes[0]); i++) {
+        bc.run = run_vd_perform;
+        bc.n = blocksizes[i];
+        bc.buf = sine;
+        bc.offset = 0;
+        snprintf(params, sizeof(params), "n=%zu", bc.n);
+        bench_measure("vd_perform", params, "sample", &bc);
+    }
+}
+
+
+static void run_manager(bench_case *bc) {
+    control_manager_perform(bc->mgr, bc->buf, bc->n);
+}
+
+static void bench_control(goat *g) {
+    static float block[1024];
+    size_t blocksizes[] = {64, 256, 1024};
+    const char *mods[] = {"lfo1", "lfo2", "lfo3", "lfo4", "rand1", "rand2", "rand3", "vodec"};
+    const char *targets[] = {"grainsize", "graindist", "graindelay", "grainpitch"};
+    bench_case bc = {0};
+    char params[80];
+
+    bench_noise(block, 1024);
+    bc.mgr = g->cfg.mgr;
+    bc.buf = block;
+    bc.run = run_manager;
+
+    for (int attached = 0; attached < 2; attached++) {
+        // attach every modulator to a parameter of the granular engine
+        if (attached) {
+            for (size_t m = 0; m < sizeof(mods) / sizeof(mods[0]); m++) {
+                control_parameter_attach(g->params[goat_param_id(g, targets[m % 4])], m / 4,
+                    control_manager_modulator_by_name(bc.mgr, mods[m]));
+            }
+        }
+
+        for (size_t b = 0; b < sizeof(blocksizes) / sizeof(blocksizes[0]); b++) {
+            bc.n = blocksizes[b];
+            snprintf(params, sizeof(params), "attached=%d n=%zu", attached ? 8 : 0, bc.n);
+            bench_measure("control_manager_perform", params, "sample", &bc);
+        }
+    }
+
+    control_manager_reset(bc.mgr);
+}
+
+
+static void run_mailbox(bench_case *bc) {
+    static int ids[64];
+    static float values[64];
+
+    // a gui thread that changed every parameter since the last block
+    for (size_t i = 0; i < bc->offset; i++) {
+        ids[i] = (int) i;
+        values[i] = control_parameter_get_float(bc->g->params[i]);
+    }
+    goat_param_queue_list(bc->g, ids, values, (int) bc->offset);
+    control_mailbox_fetch(bc->g->mailbox);
+    bc->sum += control_mailbox_apply(bc->g->mailbox, bc->g->params);
+}
+
+static void bench_mailbox(goat *g) {
+    size_t pending[] = {0, 1, (size_t) goat_param_count(g)};
+    bench_case bc = {0};
+    char params[80];
+
+    bc.g = g;
+    bc.run = run_mailbox;
+    bc.n = 1;
+
+    for (size_t i = 0; i < sizeof(pending) / sizeof(pending[0]); i++) {
+        bc.offset = min(pending[i], 64);
+        snprintf(params, sizeof(params), "pending=%zu", bc.offset);
+        bench_measure("control_mailbox_apply", params, "block", &bc);
+    }
+}
+
+static void run_snapshot(bench_case *bc) {
+    // switch between two presets, the routing changes every time
+    control_snapshot_apply(bc->g->snapshots[bc->offset], bc->mgr);
+    bc->offset ^= 1;
+    control_manager_perform(bc->mgr, bc->buf, 64);
+}
+
+static void run_morph(bench_case *bc) {
+    bc->seed = bc->seed * 1664525u + 1013904223u;
+    control_parameter_set(bc->g->morph->position, (float) (bc->seed >> 8) / (1 << 24));
+    control_manager_perform(bc->mgr, bc->buf, bc->n);
+}
+
+static void bench_snapshot(goat *g) {
+    const char *presets[] = {
+        "param-set grainsize 0.3; param-attach grainpitch 0 rand2; param-amount grainpitch 0 0.1;",
+        "param-set graindist -0.5; param-attach grainsize 1 lfo1; param-attach lfo1.frequency 0 rand1;",
+    };
+    static float block[64];
+    bench_case bc = {0};
+    char params[80];
+
+    for (int i = 0; i < 2; i++) {
+        control_manager_reset(g->cfg.mgr);
+        control_preset_apply(g->cfg.mgr, presets[i], "bench");
+        control_snapshot_capture(g->snapshots[i], g->cfg.mgr);
+    }
+
+    bc.g = g;
+    bc.mgr = g->cfg.mgr;
+    bc.buf = block;
+    bc.run = run_snapshot;
+    bc.n = 1;
+    snprintf(params, sizeof(params), "params=%d with perform", goat_param_count(g));
+    bench_measure("control_snapshot_apply", params, "switch", &bc);
+
+    // a glide between the two presets, the position moves every block
+    control_morph_load(g->morph, g->snapshots[0], g->snapshots[1]);
+    bc.run = run_morph;
+    bc.n = 64;
+    snprintf(params, sizeof(params), "params=%d moving", goat_param_count(g));
+    bench_measure("control_morph_perform", params, "sample", &bc);
+
+    control_morph_stop(g->morph);
+    control_manager_reset(g->cfg.mgr);
+}
+
+static void run_lookup(bench_case *bc) {
+    // every parameter once, as when a preset is loaded
+    for (size_t i = 0; i < bc->n; i++) bc->sum += goat_param_id(bc->g, goat_param_name(bc->g, (int) i));
+}
+
+static void bench_lookup(goat *g) {
+    bench_case bc = {0};
+    char params[80];
+
+    bc.g = g;
+    bc.run = run_lookup;
+    bc.n = goat_param_count(g);
+
+    snprintf(params, sizeof(params), "params=%zu", bc.n);
+    bench_measure("goat_param_id", params, "lookup", &bc);
+}
+
+
+static void run_graintable(bench_case *bc) {
+    // one grain in and the earliest one out, at a steady fill level
+    bc->seed = bc->seed * 1664525u + 1013904223u;
+    graintable_add_grain(bc->gt, bc->cb, NULL, (float) (bc->seed >> 16), 2048.0f, (float) ((bc->seed >> 8) % 44100), 1.0f, 2, 0);
+    bc->sum += grain_get_due(graintable_pop_grain(bc->gt));
+}
+
+static void bench_graintable(mem_arena *arena) {
+    int sizes[] = {20, 100, 500};
+    bench_case bc = {0};
+    char params[80];
+
+    bc.cb = circbuf_new(arena, BENCH_BUFFERSIZE, 0, CIRCBUF_FORMAT_FLOAT);
+    if (!bc.cb) exit(1);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        bc.gt = graintable_new(arena, sizes[s]);
+        if (!bc.gt) exit(1);
+
+        while (graintable_get_len(bc.gt) < sizes[s] - 1) {
+            graintable_add_grain(bc.gt, bc.cb, NULL, (float) (rand() % 100000), 2048.0f, (float) (rand() % 44100), 1.0f, 2, 0);
+        }
+
+        bc.run = run_graintable;
+        bc.n = 1;
+        snprintf(params, sizeof(params), "grains=%d", sizes[s]);
+        bench_measure("graintable_add_pop", params, "grain", &bc);
+    }
+
+    circbuf_free(bc.cb);
+}
+
+
+static void run_evelope(bench_case *bc) {
+    static const float ones[64] = { [0 ... 63] = 1.0f };
+
+    // a whole grain, block by block. The block is refilled, otherwise it decays into denormals
+    for (int pos = 0; pos < bc->grainsize; pos += 64) {
+        memcpy(bc->buf, ones, sizeof(ones));
+        evelope_apply(bc->ep, pos, bc->buf, min(64, bc->grainsize - pos));
+    }
+    bc->sum += bc->buf[0];
+}
+
+static void bench_evelope(mem_arena *arena) {
+    static float block[64];
+    int grainsizes[] = {441, 8820, 88200};
+    const char *types[EVELOPE_NUMTYPES] = {"none", "parabolic", "trapezoid", "cosine"};
+    evelopbuf *eb = evelopbuf_new(arena);
+    bench_case bc = {0};
+    char params[80];
+
+    if (!eb) exit(1);
+
+    for (int type = 0; type < EVELOPE_NUMTYPES; type++) {
+        for (size_t s = 0; s < sizeof(grainsizes) / sizeof(grainsizes[0]); s++) {
+            bc.ep = evelope_init(&eb->current, eb, type, grainsizes[s], 0.99f, grainsizes[s] / 4, grainsizes[s] / 4);
+            bc.buf = block;
+            bc.grainsize = grainsizes[s];
+            bc.run = run_evelope;
+            bc.n = grainsizes[s];
+            snprintf(params, sizeof(params), "type=%s grainsize=%d", types[type], grainsizes[s]);
+            bench_measure("evelope_apply", params, "sample", &bc);
+        }
+    }
+}
+
+
+static void run_synthesizer(bench_case *bc) {
+    static int i = 0;
+    grain gn;
+
+    // refill finished voices like the engine does, spread over the delay line so they do not all read the same memory
+    while (bc->syn->numfree > 0) {
+        grain_init(&gn, bc->cb, NULL,
+            (float) ((i++ * 997) % (BENCH_BUFFERSIZE / 4)) + 0.25f,
+            bc->grainsize, 0.0f, bc->speed, BENCH_BUFFERSIZE, 2, 0);
+        bc->ep = evelope_init(&bc->eb->current, bc->eb, 2, gn.gb_size, 0.99f, gn.gb_size / 8, gn.gb_size / 8);
+        synthesizer_active_grain(bc->syn, &gn, bc->ep, 0, bc->streaming, 0, bc->n);
+    }
+
+    synthesizer_write_output(bc->syn, bc->buf, bc->n);
+    bc->sum += bc->buf[0];
+}
+
+static void bench_synthesizer(void) {
+    static float out[64];
+    int voices[] = {20, 100, 500};
+    int grainsizes[] = {2048, 16384};
+    float speeds[] = {1.0f, 1.4983f};
+    bench_case bc = {0};
+    char params[80];
+
+    for (size_t v = 0; v < sizeof(voices) / sizeof(voices[0]); v++) {
+        for (size_t s = 0; s < sizeof(grainsizes) / sizeof(grainsizes[0]); s++) {
+            // the delay line, one snapshot per voice and some room for the voice state
+            int gs = grainsizes[s];
+            mem_arena *arena = mem_arena_new(sizeof(float) * (BENCH_BUFFERSIZE + (size_t) voices[v] * (2 * gs + 1))
+                + (size_t) voices[v] * 1024 + ARENABASESIZE);
+            bc.eb = arena ? evelopbuf_new(arena) : NULL;
+            if (!bc.eb) exit(1);
+
+            bc.cb = circbuf_new(arena, BENCH_BUFFERSIZE, 0, CIRCBUF_FORMAT_FLOAT);
+            bc.syn = synthesizer_new(arena, voices[v], voices[v], 2 * gs + 1);
+            if (!bc.cb || !bc.syn) exit(1);
+
+            for (int i = 0; i < BENCH_BUFFERSIZE / 64; i++) {
+                bench_noise(out, 64);
+                circbuf_write_block(bc.cb, out, 64);
+            }
+            // keep the write tap far ahead, so streamed grains are never overwritten
+            bc.cb->writetap.position = BENCH_BUFFERSIZE - 1;
+
+            for (size_t p = 0; p < sizeof(speeds) / sizeof(speeds[0]); p++) {
+                for (bc.streaming = 1; bc.streaming >= 0; bc.streaming--) {
+                    bc.run = run_synthesizer;
+                    bc.buf = out;
+                    bc.n = 64;
+                    bc.grainsize = gs;
+                    bc.speed = speeds[p];
+
+                    // drop the voices of the previous configuration
+                    for (int i = 0; i < bc.syn->length; i++) {
+                        if (SYNTH_IS_LIVE(bc.syn, i)) synthesizer_release_voice(bc.syn, i);
+                    }
+
+                    snprintf(params, sizeof(params), "voices=%d grainsize=%d speed=%g mode=%s",
+                        voices[v], gs, speeds[p], bc.streaming ? "stream" : "copy");
+                    bench_measure("synthesizer_write_output", params, "sample", &bc);
+                }
+            }
+
+            circbuf_free(bc.cb);
+            mem_arena_free(arena);
+        }
+    }
+}
+
+
+static void bench_write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    bench_result *r;
+
+    if (!f) {
+        fprintf(stderr, "bench_suite: could not write %s\n", path);
+        exit(1);
+    }
+
+    // one benchmark per line, so that the compare mode can read it back without a json parser
+    fprintf(f, "{\n  \"repeat\": %d,\n  \"benchmarks\": [\n", BENCH_REPEAT);
+    for (int i = 0; i < bench_numresults; i++) {
+        r = &bench_results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"params\": \"%s\", \"unit\": \"%s\", \"ns_per_sample\": %.4f, \"cycles_per_sample\": ",
+            r->name, r->params, r->unit, r->ns);
+        if (r->cycles >= 0.0) fprintf(f, "%.4f}", r->cycles);
+        else fprintf(f, "null}");
+        fprintf(f, "%s\n", i < bench_numresults - 1 ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+    fclose(f);
+}
+
+static int bench_json_string(const char *line, const char *key, char *dst, size_t size) {
+    char pattern[32];
+    const char *start, *end;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    if (!(start = strstr(line, pattern))) return 0;
+    start += strlen(pattern);
+    if (!(end = strchr(start, '"')) || (size_t) (end - start) >= size) return 0;
+
+    memcpy(dst, start, end - start);
+    dst[end - start] = '\0';
+    return 1;
+}
+
+/**
+ * @brief compare the results against a baseline written by bench_write_json
+ *
+ * @return int the number of regressions
+ */
+static int bench_compare(const char *path, double threshold) {
+    char line[512], name[48], params[80], *ns;
+    int regressions = 0, matched = 0;
+    double base, change;
+    bench_result *r;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "bench_suite: could not read %s\n", path);
+        exit(1);
+    }
+
+    printf("%-26s %-52s %10s %10s %8s\n", "benchmark", "params", "baseline", "current", "change");
+
+    while (fgets(line, sizeof(line), f)) {
+        if (!bench_json_string(line, "name", name, sizeof(name))) continue;
+        if (!bench_json_string(line, "params", params, sizeof(params))) continue;
+        if (!(ns = strstr(line, "\"ns_per_sample\": "))) continue;
+        base = atof(ns + strlen("\"ns_per_sample\": "));
+
+        for (r = bench_results; r < bench_results + bench_numresults; r++) {
+            if (strcmp(r->name, name) != 0 || strcmp(r->params, params) != 0) continue;
+
+            matched++;
+            change = base > 0.0 ? (r->ns - base) / base * 100.0 : 0.0;
+            printf("%-26s %-52s %10.3f %10.3f %+7.1f%%%s\n", name, params, base, r->ns, change,
+                change > threshold ? "  REGRESSION" : change < -threshold ? "  improved" : "");
+            if (change > threshold) regressions++;
+            break;
+        }
+    }
+
+    fclose(f);
+
+    printf("%d of %d benchmarks compared, %d regressions (threshold %g%%)\n", matched, bench_numresults, regressions, threshold);
+    return regressions;
+}
+
+
+int main(int argc, char **argv) {
+    const char *jsonpath = NULL, *baselinepath = NULL;
+    double threshold = 10.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:c:t:f:h")) != -1) {
+        switch (opt) {
+            case 'j': jsonpath = optarg; break;
+            case 'c': baselinepath = optarg; break;
+            case 't': threshold = atof(optarg); break;
+            case 'f': bench_filter = optarg; break;
+            default:
+                fprintf(stderr, "usage: bench_suite [-j results.json] [-c baseline.json] [-t percent] [-f filter]\n");
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    goat_config cfg = { .sample_rate = 44100, .block_size = 64 };
+    goat *g = goat_new(&cfg);
+    mem_arena *arena = mem_arena_new(sizeof(float) * BENCH_BUFFERSIZE * (CIRCBUF_FORMAT_COUNT + 2) + ARENABASESIZE);
+
+    if (!g || !arena) {
+        fprintf(stderr, "bench_suite: allocation failed\n");
+        return 1;
+    }
+
+    srand(1);
+
+    bench_circbuf(arena);
+    bench_vocaldetector(arena, cfg.sample_rate);
+    bench_control(g);
+    bench_lookup(g);
+    bench_mailbox(g);
+    bench_snapshot(g);
+    bench_graintable(arena);
+    bench_evelope(arena);
+    bench_synthesizer();
+
+    goat_free(g);
+    mem_arena_free(arena);
+
+    if (jsonpath) bench_write_json(jsonpath);
+    if (baselinepath) return bench_compare(baselinepath, threshold) > 0;
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file bench_synthesizer.c
+ * @brief microbenchmark of synthesizer_write_output for different numbers of active voices
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "synthesizer/synthesizer.h"
+#include "evelopbuf/evelopbuf.h"
+#include "util/circbuf.h"
+
+
+#define BENCH_BUFFERSIZE 262144
+#define BENCH_GRAINSIZE 4096
+#define BENCH_BLOCKSIZE 64
+#define BENCH_SAMPLES (1 << 20)
+
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_fill(synthesizer *syn, circbuf *cb, evelope *ep, int streaming) {
+    grain gn;
+    int i = 0;
+
+    // spread the voices over the delay line, so they do not all read the same memory
+    while (syn->numfree > 0) {
+        grain_init(&gn, cb, NULL,
+            (float) ((i++ * 997) % (BENCH_BUFFERSIZE / 2)),
+            BENCH_GRAINSIZE, 0.0f, 1.0f, BENCH_BUFFERSIZE, 2, 0);
+        synthesizer_active_grain(syn, &gn, ep, 0, streaming, 0, BENCH_BLOCKSIZE);
+    }
+}
+
+static void bench_run(int numvoices, int streaming) {
+    // the delay line, one snapshot per voice and some room for the voice state
+    mem_arena *arena = mem_arena_new(sizeof(float) * (BENCH_BUFFERSIZE + (size_t) numvoices * (BENCH_GRAINSIZE + 1))
+        + (size_t) numvoices * 1024 + ARENABASESIZE);
+    circbuf *cb = arena ? circbuf_new(arena, BENCH_BUFFERSIZE, numvoices, CIRCBUF_FORMAT_FLOAT) : NULL;
+    synthesizer *syn = arena ? synthesizer_new(arena, numvoices, numvoices, BENCH_GRAINSIZE + 1) : NULL;
+    evelopbuf *eb = arena ? evelopbuf_new(arena) : NULL;
+    evelope *ep = eb ? evelope_init(&eb->current, eb, 2, BENCH_GRAINSIZE + 1, 0.99f, 256, 256) : NULL;
+    float out[BENCH_BLOCKSIZE];
+    double start, elapsed = 0.0, sum = 0.0;
+    size_t i;
+
+    if (!cb || !syn || !ep) {
+        fprintf(stderr, "bench_synthesizer: allocation failed\n");
+        exit(1);
+    }
+
+    for (i = 0; i < cb->size; i++) {
+        float x = (float) rand() / RAND_MAX - 0.5f;
+        circbuf_write_block(cb, &x, 1);
+    }
+    // keep the write tap far ahead, so streamed grains are never overwritten
+    cb->writetap.position = BENCH_BUFFERSIZE - 1;
+
+    for (i = 0; i < BENCH_SAMPLES; i += BENCH_BLOCKSIZE) {
+        // refill finished voices outside of the measurement
+        bench_fill(syn, cb, ep, streaming);
+
+        start = bench_now();
+        synthesizer_write_output(syn, out, BENCH_BLOCKSIZE);
+        elapsed += bench_now() - start;
+
+        sum += out[0];
+    }
+
+    printf("%-6s voices: %5d  %8.2f ns/sample  %6.3f ns/voice-sample  (checksum %g)\n",
+        streaming ? "stream" : "copy",
+        numvoices,
+        elapsed * 1e9 / BENCH_SAMPLES,
+        elapsed * 1e9 / BENCH_SAMPLES / numvoices,
+        sum);
+
+    circbuf_free(cb);
+    mem_arena_free(arena);
+}
+
+int main(void) {
+    int voices[] = {20, 200, 2000};
+
+    for (size_t i = 0; i < sizeof(voices) / sizeof(voices[0]); i++) {
+        bench_run(voices[i], 0);
+        bench_run(voices[i], 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file mailbox.h
+ * @brief lock-free hand over of parameter updates from a control thread to the audio thread
+ * 
+ * The mailbox holds one value per parameter together with the number of the list that posted it.
+ * Posting a value overwrites a pending one, so a flood of updates between two blocks is coalesced into the last value
+ * of each parameter. The audio thread fetches every value that was posted since the last block and applies them at
+ * the start of a block. A sequence counter that is odd while a list is posted or the mailbox is cleared tells the audio
+ * thread to leave everything for the next block, so a list or a clear is never applied partially. The audio thread
+ * only reads the shared state, except for the ring below. Neither side ever waits or allocates memory.
+ * 
+ * Changes to the modulation slots (attaching, detaching and amounts) are kept in order in a small ring,
+ * as they change the modulation graph that the audio thread walks. They are applied before the values.
+ * 
+ * A clear drops everything that was posted before it and hands a request to the audio thread, e.g. to reset or replace
+ * the whole control state. The audio thread sees the request in the same block as the updates posted after it.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "util/mem.h"
+#include "control/parameter.h"
+
+
+#define CONTROL_MAILBOX_ROUTES 64 /**< number of changes to modulation slots that can wait for the next block */
+#define CONTROL_MAILBOX_NOREQUEST -1 /**< returned by @ref control_mailbox_fetch if the mailbox was not cleared */
+
+
+/**
+ * @brief what a routing change does to a modulation slot
+ */
+typedef enum {
+    CONTROL_ROUTE_ATTACH, /**< attach a modulator to the slot */
+    CONTROL_ROUTE_DETACH, /**< detach the modulator from the slot */
+    CONTROL_ROUTE_AMOUNT  /**< set the amount of the slot */
+} control_route_type;
+
+/**
+ * @struct control_route
+ * @brief a change to a modulation slot of a parameter
+ */
+typedef struct {
+    control_route_type type; /**< what to change */
+    int id; /**< the parameter id */
+    int slot; /**< the slot of the parameter */
+    control_modulator *mod; /**< the modulator to attach */
+    float amount; /**< the new amount */
+} control_route;
+
+
+/**
+ * @struct control_mailbox
+ * @brief pending parameter updates, addressed by parameter id
+ */
+typedef struct {
+    _Atomic uint32_t *values; /**< the bits of the last float posted for each parameter */
+    atomic_uint *stamps; /**< the number of the list that posted the value of each parameter, 0 if none */
+    atomic_uint sequence; /**< incremented before and after a list is posted or the mailbox is cleared */
+    atomic_uint stamp; /**< number of lists posted so far */
+    control_route *routes; /**< ring of routing changes, @ref CONTROL_MAILBOX_ROUTES entries */
+    atomic_uint routehead; /**< number of routing changes posted so far */
+    atomic_uint routetail; /**< number of routing changes applied or dropped so far */
+    atomic_uint clears; /**< number of clears so far */
+    atomic_uint clearstamp; /**< the lists up to this one were posted before the last clear */
+    atomic_uint clearhead; /**< the routing changes before this one were posted before the last clear */
+    atomic_int request; /**< the request of the last clear */
+    atomic_uint applied; /**< the values of the lists up to this one have been applied or dropped */
+
+    // only used by the audio thread
+    unsigned int fetchedstamp; /**< the lists up to this one have been fetched */
+    unsigned int fetchedclears; /**< number of clears fetched so far */
+    unsigned int fetchedtail; /**< the first fetched routing change */
+    unsigned int fetchedhead; /**< the routing change after the last fetched one */
+    int *ids; /**< the parameters of the fetched values */
+    float *fetched; /**< the fetched values */
+    int numfetched; /**< number of fetched values */
+
+    int size; /**< number of parameters */
+} control_mailbox;
+
+
+/**
+ * @memberof control_mailbox
+ * @brief create a mailbox
+ * 
+ * @param arena the arena the mailbox is allocated from
+ * @param size the number of parameters, i.e. the largest id + 1
+ * @return control_mailbox* the new mailbox or NULL if the allocation failed
+ */
+control_mailbox *control_mailbox_new(mem_arena *arena, int size);
+
+/**
+ * @memberof control_mailbox
+ * @brief post new values for a list of parameters
+ * 
+ * All values of the list are applied in the same block. Only one thread may post to a mailbox at a time.
+ * 
+ * @param mb the mailbox
+ * @param ids the parameter ids. Ids out of range are ignored
+ * @param values the new values
+ * @param count the number of values
+ * @return int the number of values posted
+ */
+int control_mailbox_post(control_mailbox *mb, const int *ids, const float *values, int count);
+
+/**
+ * @memberof control_mailbox
+ * @brief post a change to a modulation slot
+ * 
+ * Routing changes are applied in the order they were posted. Only one thread may post to a mailbox at a time.
+ * 
+ * @param mb the mailbox
+ * @param route the change. The parameter id and slot must be valid
+ * @return int 1 on success, 0 if @ref CONTROL_MAILBOX_ROUTES changes are already waiting
+ */
+int control_mailbox_route(control_mailbox *mb, const control_route *route);
+
+/**
+ * @memberof control_mailbox
+ * @brief look up the value of a parameter that has not been applied yet
+ * 
+ * This may be called by the thread that posts and by the audio thread. Values that were posted before a clear are not pending.
+ * 
+ * @param mb the mailbox
+ * @param id the parameter id
+ * @param value receives the pending value
+ * @return int 1 if an update is pending, 0 otherwise
+ */
+int control_mailbox_peek(control_mailbox *mb, int id, float *value);
+
+/**
+ * @memberof control_mailbox
+ * @brief drop all pending updates and pass a request to the audio thread
+ * 
+ * Values and routing changes that were posted before are dropped. Only the thread that posts may clear the mailbox.
+ * If the mailbox is cleared several times before the audio thread fetches, only the last request is passed on.
+ * 
+ * @param mb the mailbox
+ * @param request what the audio thread should do before it applies the updates posted after the clear. Must not be
+ * @ref CONTROL_MAILBOX_NOREQUEST
+ * @return unsigned int the number of the clear, counting from 1
+ */
+unsigned int control_mailbox_clear(control_mailbox *mb, int request);
+
+/**
+ * @memberof control_mailbox
+ * @brief take the updates that were posted since the last block
+ * 
+ * This is meant to be called by the audio thread at the start of a block, followed by @ref control_mailbox_apply.
+ * If a list is being posted or the mailbox is cleared at the same time, nothing is taken and everything is left
+ * for the next call.
+ * 
+ * @param mb the mailbox
+ * @return int the request of the last clear since the previous call or @ref CONTROL_MAILBOX_NOREQUEST.
+ * The caller carries it out before it calls @ref control_mailbox_apply
+ */
+int control_mailbox_fetch(control_mailbox *mb);
+
+/**
+ * @memberof control_mailbox
+ * @brief apply the routing changes and set the offsets of the parameters that @ref control_mailbox_fetch took
+ * 
+ * This is meant to be called by the audio thread.
+ * 
+ * @param mb the mailbox
+ * @param params the parameters, indexed by their id
+ * @return int the number of values and routing changes that were applied
+ */
+int control_mailbox_apply(control_mailbox *mb, control_parameter **params);
@@ -12,19 +12,63 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include "uthash/utlist.h"
+#include "util/mem.h"
 #include "control/parameter.h"
 #include "control/modulator.h"
 
 
+/**
+ * @struct control_index_entry
+ * @brief one slot of a @ref control_index
+ */
+typedef struct {
+    const char *name; /**< the name of the item or NULL if the slot is empty */
+    uint32_t hash; /**< the hash of the name */
+    void *item; /**< the parameter or modulator */
+} control_index_entry;
+
+/**
+ * @struct control_index
+ * @brief open addressing hash table that finds parameters and modulators by their name
+ * 
+ * A lookup hashes the name once and only compares the strings of entries with the same hash.
+ */
+typedef struct {
+    control_index_entry *entries; /**< the slots of the table */
+    size_t capacity; /**< number of slots, a power of two */
+    size_t count; /**< number of occupied slots, at most half of the capacity */
+} control_index;
+
+/**
+ * @struct control_step
+ * @brief one entry of the compiled modulation graph, either a modulator or a parameter to update
+ */
+typedef struct {
+    control_modulator *mod; /**< the modulator to perform or NULL */
+    control_parameter *param; /**< the parameter to update or NULL */
+} control_step;
+
 /**
  * @struct control_manager
  * @brief manager to hold all parameters and modulators
  * 
+ * The lists of parameters and modulators are compiled into a flat array of steps, see @ref control_manager_compile.
  */
 typedef struct {
+    mem_arena *arena; /**< the arena parameters and modulators are allocated from */
     control_parameter *parameters; /**< list of all parameters */
     control_modulator *modulators; /**< list of all modulators */
+    size_t numblocks; /**< number of blocks performed so far */
+    control_index paramindex; /**< index of the parameters by name */
+    control_index modindex; /**< index of the modulators by name */
+
+    control_step *steps; /**< the compiled modulation graph in the order of evaluation */
+    int numsteps; /**< number of compiled steps */
+    int stepcapacity; /**< number of steps that fit into @ref control_manager.steps */
+    int numactive; /**< number of modulators that have a consumer and are performed */
+    int dirty; /**< whether the graph has changed since it was compiled */
 } control_manager;
 
 
@@ -32,30 +76,46 @@ typedef struct {
  * @memberof control_manager
  * @brief create a new control manager
  * 
+ * The manager, its parameters and its modulators are released together with the arena.
+ * 
+ * @param arena the arena the manager and everything added to it are allocated from
  * @return control_manager* a pointer to the new control manager or NULL if the allocation failed
  */
-control_manager *control_manager_new();
+control_manager *control_manager_new(mem_arena *arena);
 
 /**
  * @memberof control_manager
- * @brief free a control manager
+ * @brief add a parameter
  * 
- * @param mgr the control manager to free
+ * @param mgr the control manager to add the parameter to
+ * @param name the name of the parameter
+ * @param default_value the default value of the parameter
+ * @param min the minimum value of the parameter
+ * @param max the maximum value of the parameter
+ * @return control_parameter* a pointer to the new parameter or NULL if the allocation failed
  */
-void control_manager_free(control_manager *mgr);
+control_parameter *control_manager_parameter_add(control_manager *mgr,
+    const char *name,
+    float default_value,
+    float min,
+    float max);
 
 /**
  * @memberof control_manager
- * @brief add a parameter
+ * @brief add a parameter that is read by a modulator
+ * 
+ * The modulator is only performed while one of its consumers is in use, see @ref control_manager_compile.
  * 
  * @param mgr the control manager to add the parameter to
+ * @param owner the modulator that reads the parameter
  * @param name the name of the parameter
  * @param default_value the default value of the parameter
  * @param min the minimum value of the parameter
  * @param max the maximum value of the parameter
  * @return control_parameter* a pointer to the new parameter or NULL if the allocation failed
  */
-control_parameter *control_manager_parameter_add(control_manager *mgr,
+control_parameter *control_manager_modulator_parameter_add(control_manager *mgr,
+    control_modulator *owner,
     const char *name,
     float default_value,
     float min,
@@ -65,15 +125,33 @@ control_parameter *control_manager_parameter_add(control_manager *mgr,
  * @memberof control_manager
  * @brief remove a parameter
  * 
+ * The parameter is only unlinked, its memory is returned with the arena.
+ * 
  * @param mgr the control manager to remove the parameter from
  * @param p the parameter to remove
  */
 void control_manager_parameter_remove(control_manager *mgr, control_parameter *p);
 
+/**
+ * @memberof control_manager
+ * @brief compute a parameter at every sample instead of once per block
+ * 
+ * The parameter gets a ramp from the value of the previous block to the current value, see @ref param_at.
+ * Only parameters whose consumers read them at sample offsets should request this.
+ * 
+ * @param mgr the control manager the parameter belongs to
+ * @param p the parameter
+ * @param maxblock the largest block size the ramp is computed for. Larger blocks fall back to the block value
+ * @return int 1 on success, 0 if the allocation failed
+ */
+int control_manager_parameter_audiorate(control_manager *mgr, control_parameter *p, size_t maxblock);
+
 /**
  * @memberof control_manager
  * @brief find a parameter by its name
  * 
+ * The lookup takes constant time. If several parameters have the same name, the one added first is returned.
+ * 
  * @param mgr the control manager to search in
  * @param name the name of the parameter to find
  * @return control_parameter* a pointer to the parameter or NULL if not found
@@ -100,6 +178,8 @@ control_modulator *control_manager_modulator_add(control_manager *mgr,
  * @memberof control_manager
  * @brief remove a modulator
  * 
+ * The modulator is only unlinked, its memory is returned with the arena.
+ * 
  * @param mgr the control manager to remove the modulator from
  * @param m the modulator to remove
  */
@@ -109,6 +189,8 @@ void control_manager_modulator_remove(control_manager *mgr, control_modulator *m
  * @memberof control_manager
  * @brief find a modulator by its name
  * 
+ * The lookup takes constant time. If several modulators have the same name, the one added first is returned.
+ * 
  * @param mgr the control manager to search in
  * @param name the name of the modulator to find
  * @return control_modulator* a pointer to the modulator or NULL if not found
@@ -116,10 +198,42 @@ void control_manager_modulator_remove(control_manager *mgr, control_modulator *m
 control_modulator *control_manager_modulator_by_name(control_manager *mgr, const char *name);
 
 
+/**
+ * @memberof control_manager
+ * @brief reset all parameters to their defaults and detach all modulators
+ * 
+ * @param mgr the control manager
+ */
+void control_manager_reset(control_manager *mgr);
+
+
+/**
+ * @memberof control_manager
+ * @brief compile the modulation graph
+ * 
+ * Starting at the parameters read by the engine, the modulators attached to them and, transitively, the modulators
+ * attached to their parameters are collected. They are ordered so that every modulator runs after the modulators it
+ * depends on, which removes the delay of one block per link of a chain. Modulators that nothing depends on are left out,
+ * except for root modulators, which are performed first.
+ * If the modulators form a cycle, the link that closes it reads the value of the previous block.
+ * Parameters of the left out modulators are updated after all others, so their values stay up to date.
+ * 
+ * Attaching or detaching a modulator, as well as adding or removing parameters or modulators, marks the graph
+ * as dirty and @ref control_manager_perform compiles it again before the next block.
+ * 
+ * @param mgr the control manager
+ * @return int 1 on success, 0 if the allocation failed
+ */
+int control_manager_compile(control_manager *mgr);
+
 /**
  * @memberof control_manager
  * @brief run the perform method on all modulators and parameters
  * 
+ * The modulators and parameters are evaluated in the order of the compiled graph, see @ref control_manager_compile.
+ * Parameters with a ramp get the value for each sample of the block if their value changed. The ramp starts
+ * at the value of the previous block, except in the first block, which starts at the current value.
+ * 
  * @param mgr the control manager
  * @param in the input buffer
  * @param n the number of samples to process
@@ -12,6 +12,7 @@
 #pragma once
 
 #include <stddef.h>
+#include "util/mem.h"
 
 
 struct control_modulator;
@@ -36,6 +37,8 @@ typedef struct control_modulator {
     control_modulator_perform_method perform_method; /**< the perform callback function */
 
     float value; /**< the current value of the modulator */
+    int mark; /**< scratch state of @ref control_manager_compile */
+    int root; /**< whether the modulator is performed even if nothing is attached to it, before the parameters of the engine */
 
     struct control_modulator *next; /**< the next modulator in the list */
 } control_modulator;
@@ -47,19 +50,13 @@ typedef struct control_modulator {
  * More specifically, not only the modulator itself, but also memory for the subclass struct is
  * allocated. Therefore, subclasses can store additional data.
  * 
+ * @param arena the arena the modulator and its name are allocated from
  * @param name the name of the modulator
  * @param perform_method the perform callback function
  * @param subclass_size the size of the subclass to allocate memory for
  * @return control_modulator* a pointer to the new modulator or NULL if memory allocation failed
  */
-control_modulator *control_modulator_new(const char *name,
+control_modulator *control_modulator_new(mem_arena *arena,
+        const char *name,
         control_modulator_perform_method perform_method,
         size_t subclass_size);
-
-/**
- * @memberof control_modulator
- * @brief free a modulator
- * 
- * @param modulator the modulator to free
- */
-void control_modulator_free(control_modulator *modulator);
@@ -0,0 +1,80 @@
+/**
+ * @file morph.h
+ * @brief gliding between two snapshots of the control state with a single parameter
+ * 
+ * The morph is a modulator that is always performed, before the parameters of the engine. Its parameter
+ * `<name>.position` goes from 0 (the first snapshot) to 1 (the second snapshot) and can be modulated like any other.
+ * Whenever the position changes, the offsets and amounts of all parameters are interpolated between the snapshots.
+ * Discrete parameters (see @ref control_parameter_discrete) switch at the midpoint. A modulator that is only attached
+ * in one of the snapshots fades in or out over the whole way. If a slot holds different modulators in the two snapshots,
+ * the first one fades out towards the midpoint and the second one fades in after it.
+ * 
+ * As long as the position does not move, the parameters are left alone and can be changed as usual.
+ * The morph itself is also a modulation source, its value is the position.
+ */
+
+#pragma once
+
+#include "control/manager.h"
+#include "control/snapshot.h"
+
+
+/**
+ * @struct control_morph
+ * @brief interpolates the control state between two snapshots
+ */
+typedef struct {
+    control_modulator super; /**< the modulator super class instance */
+    control_manager *mgr; /**< the manager whose parameters are morphed */
+    control_parameter *position; /**< the position between the snapshots, from 0 to 1 */
+    control_snapshot *from; /**< the state at position 0 */
+    control_snapshot *to; /**< the state at position 1 */
+    control_modulator **mods; /**< the modulators of the manager in list order, to resolve the slots of the snapshots */
+    int active; /**< whether both snapshots are loaded */
+    float lastposition; /**< the position the parameters were last written for */
+} control_morph;
+
+
+/**
+ * @memberof control_morph
+ * @brief create a morph and its position parameter
+ * 
+ * The snapshots of the morph cover the parameters that exist at this point, so the morph must be created after all other
+ * parameters and modulators.
+ * 
+ * @param mgr the control manager
+ * @param name the name of the morph, the position parameter is called `<name>.position`
+ * @return control_morph* the new morph or NULL if the allocation failed
+ */
+control_morph *control_morph_new(control_manager *mgr, const char *name);
+
+/**
+ * @memberof control_morph
+ * @brief start morphing between two snapshots
+ * 
+ * The snapshots are copied, so they may be changed afterwards. Nothing is allocated.
+ * 
+ * @param mo the morph
+ * @param from the state at position 0
+ * @param to the state at position 1
+ * @return int 1 on success, 0 if one of the snapshots is empty
+ */
+int control_morph_load(control_morph *mo, const control_snapshot *from, const control_snapshot *to);
+
+/**
+ * @memberof control_morph
+ * @brief stop morphing, the parameters keep their current state
+ * 
+ * @param mo the morph
+ */
+void control_morph_stop(control_morph *mo);
+
+/**
+ * @memberof control_morph
+ * @brief the perform method of the morph, writes the parameters if the position changed
+ * 
+ * @param mo the morph
+ * @param in the input buffer, unused
+ * @param n the number of samples, unused
+ */
+void control_morph_perform(control_morph *mo, float *in, int n);
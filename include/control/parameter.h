@@ -13,6 +13,7 @@
 
 #include "control/modulator.h"
 #include <stddef.h>
+#include "util/mem.h"
 
 
 
@@ -24,6 +25,12 @@
  */
 #define param(type, ...) control_parameter_get_ ## type(__VA_ARGS__)
 
+/**
+ * @ref param_at(type, ...)
+ * @brief shorthand method to get the value of a parameter at a sample of the current block cast to a specific type
+ */
+#define param_at(type, ...) control_parameter_get_ ## type ## _at(__VA_ARGS__)
+
 
 /**
  * @struct control_parameter_slot
@@ -39,6 +46,10 @@ typedef struct {
  * 
  * For more detailed info on how the @ref control_parameter.value is calculated,
  * see @ref control_manager.control_manager_perform
+ * 
+ * Parameters are computed once per block. Consumers that need smooth changes inside a block can request
+ * a ramp with @ref control_manager_parameter_audiorate. The value then glides linearly from the value of the
+ * previous block to the current one and can be read at any sample with @ref param_at.
  */
 typedef struct control_parameter {
     char *name; /**< the name of the parameter */
@@ -50,6 +61,16 @@ typedef struct control_parameter {
     float max; /**< the maximum value of the parameter */
     float value; /**< the current computed value of the parameter */
     float reset; /**< the default value for reset */
+    int discrete; /**< whether the parameter selects one of several options, so that it must not be interpolated */
+
+    int id; /**< the id the owner of the manager addresses the parameter with or -1 */
+    control_modulator *owner; /**< the modulator that reads this parameter or NULL if the engine reads it */
+    int *graphdirty; /**< flag of the manager that is raised when the modulators attached to this parameter change */
+    int mark; /**< scratch state of @ref control_manager_compile */
+
+    float *ramp; /**< the value at each sample of the current block or NULL if the parameter is only computed per block */
+    size_t rampcapacity; /**< number of samples the ramp can hold */
+    size_t ramplength; /**< number of valid samples in the ramp, 0 if the last block did not fit */
 
     struct control_parameter *next; /**< the next parameter in the list */
 } control_parameter;
@@ -58,27 +79,21 @@ typedef struct control_parameter {
  * @memberof control_parameter
  * @brief creates a new parameter
  * 
+ * @param arena the arena the parameter and its name are allocated from
  * @param name the name of the parameter
  * @param default_value the initial value of the parameter
  * @param min the minimum value of the parameter
  * @param max the maximum value of the parameter
  * @return control_parameter* 
  */
-control_parameter *control_parameter_new(const char *name, float default_value, float min, float max);
-
-/**
- * @memberof control_parameter
- * @brief frees a parameter
- * 
- * @param p the parameter to free
- */
-void control_parameter_free(control_parameter *p);
+control_parameter *control_parameter_new(mem_arena *arena, const char *name, float default_value, float min, float max);
 
 
 /**
  * @memberof control_parameter
  * @brief connects a modulator to a parameter
  * If the parameter already has a modulator attached, it will be replaced.
+ * The manager of the parameter recompiles its modulation graph before the next block.
  * 
  * @param p the parameter
  * @param slot the slot to connect the modulator to
@@ -90,12 +105,24 @@ void control_parameter_attach(control_parameter *p, size_t slot, control_modulat
  * @memberof control_parameter
  * @brief disconnects a modulator from a parameter
  * If the parameter has no modulator attached, this function does nothing.
+ * The manager of the parameter recompiles its modulation graph before the next block.
  * 
  * @param p the parameter
  * @param slot the slot to disconnect the modulator from
  */
 void control_parameter_detach(control_parameter *p, size_t slot);
 
+/**
+ * @memberof control_parameter
+ * @brief marks a parameter as a selection of options, e.g. a curve or an on/off switch
+ * 
+ * A morph switches such parameters at the midpoint instead of interpolating them.
+ * 
+ * @param p the parameter
+ * @param discrete 1 if the parameter is discrete, 0 otherwise
+ */
+void control_parameter_discrete(control_parameter *p, int discrete);
+
 /**
  * @memberof control_parameter
  * @brief sets the amount of influence of a modulator on a parameter
@@ -133,3 +160,25 @@ float control_parameter_get_float(control_parameter *p);
  * @return int the value of the parameter
  */
 int control_parameter_get_int(control_parameter *p);
+
+/**
+ * @memberof control_parameter
+ * @brief gets the value of a parameter at a sample of the current block as a float
+ * 
+ * Without a ramp, or beyond its end, this is the value of the block.
+ * 
+ * @param p the parameter
+ * @param i the sample index inside the current block
+ * @return float the value of the parameter at that sample
+ */
+float control_parameter_get_float_at(control_parameter *p, int i);
+
+/**
+ * @memberof control_parameter
+ * @brief gets the value of a parameter at a sample of the current block cast as an integer
+ * 
+ * @param p the parameter
+ * @param i the sample index inside the current block
+ * @return int the value of the parameter at that sample
+ */
+int control_parameter_get_int_at(control_parameter *p, int i);
@@ -0,0 +1,43 @@
+/**
+ * @file preset.h
+ * @brief reading presets in the text format of the `preset_*.txt` files
+ * 
+ * A preset is a sequence of messages terminated by `;`, the same messages that are sent to `goat~`:
+ * 
+ *     name Under_Water;
+ *     # comments start with a hash;
+ *     param-set grainsize 0.2;
+ *     param-attach grainpitch 0 rand2;
+ *     param-amount grainpitch 0 0.09;
+ * 
+ * `param-set`, `param-amount`, `param-attach`, `param-detach` and `param-reset` are supported.
+ */
+
+#pragma once
+
+#include "control/manager.h"
+
+
+#define CONTROL_PRESET_MAXARGS 8 /**< maximum number of atoms in a preset message */
+
+
+/**
+ * @brief apply the messages of a preset to the parameters of a control manager
+ * 
+ * Invalid messages are reported on stderr and skipped, the remaining messages are still applied.
+ * 
+ * @param mgr the control manager
+ * @param text the preset as text. It is not modified
+ * @param source the name of the preset used in error messages, e.g. the file name
+ * @return int the number of invalid messages
+ */
+int control_preset_apply(control_manager *mgr, const char *text, const char *source);
+
+/**
+ * @brief read a preset file and apply it to the parameters of a control manager
+ * 
+ * @param mgr the control manager
+ * @param path the path to the preset file
+ * @return int the number of invalid messages or -1 if the file could not be read
+ */
+int control_preset_load(control_manager *mgr, const char *path);
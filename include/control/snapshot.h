@@ -0,0 +1,121 @@
+/**
+ * @file snapshot.h
+ * @brief binary snapshots of the whole control state for instant preset switching
+ * 
+ * A snapshot holds the offset of every parameter and the modulator and amount of each of its slots. It is
+ * allocated once for a control manager, so capturing and applying it never allocates memory.
+ * Applying a snapshot has the same result as `param-reset` followed by the messages of a text preset, but
+ * without the intermediate states and without looking up any names.
+ * 
+ * In a file, parameters and modulators are stored by name, so that snapshots survive added or reordered parameters.
+ * All numbers are little endian:
+ * 
+ *     "GOATSNAP"  magic
+ *     u32         version
+ *     u32         number of parameters
+ *     u32         number of slots per parameter
+ *     per parameter:
+ *         u16 + bytes   name
+ *         f32           offset
+ *         per slot:
+ *             u16 + bytes   name of the attached modulator, empty if none
+ *             f32           amount
+ */
+
+#pragma once
+
+#include "util/mem.h"
+#include "control/manager.h"
+
+
+#define CONTROL_SNAPSHOT_MAGIC "GOATSNAP" /**< the first bytes of a snapshot file */
+#define CONTROL_SNAPSHOT_VERSION 1 /**< the version of the file format */
+
+
+/**
+ * @struct control_snapshot_entry
+ * @brief the state of one parameter
+ */
+typedef struct {
+    float offset; /**< the value of the parameter before modulation */
+    float amounts[CONTROL_NUM_SLOTS]; /**< the amount of each slot */
+    int mods[CONTROL_NUM_SLOTS]; /**< the position of the attached modulator in the list of the manager or -1 */
+} control_snapshot_entry;
+
+/**
+ * @struct control_snapshot
+ * @brief the state of all parameters of a control manager
+ */
+typedef struct {
+    control_snapshot_entry *entries; /**< one entry per parameter, in the order of the list of the manager */
+    int numparams; /**< number of parameters */
+    int nummods; /**< number of modulators */
+    int valid; /**< whether the snapshot holds a state */
+} control_snapshot;
+
+
+/**
+ * @memberof control_snapshot
+ * @brief create an empty snapshot for the parameters of a control manager
+ * 
+ * The snapshot is only valid for the manager as it is now, parameters and modulators must not be added or removed afterwards.
+ * 
+ * @param arena the arena the snapshot is allocated from
+ * @param mgr the control manager
+ * @return control_snapshot* the new snapshot or NULL if the allocation failed
+ */
+control_snapshot *control_snapshot_new(mem_arena *arena, control_manager *mgr);
+
+/**
+ * @memberof control_snapshot
+ * @brief store the current state of the parameters
+ * 
+ * @param snap the snapshot
+ * @param mgr the control manager
+ */
+void control_snapshot_capture(control_snapshot *snap, control_manager *mgr);
+
+/**
+ * @memberof control_snapshot
+ * @brief copy the state of one snapshot into another of the same manager
+ * 
+ * @param dst the snapshot to overwrite
+ * @param src the snapshot to copy
+ */
+void control_snapshot_copy(control_snapshot *dst, const control_snapshot *src);
+
+/**
+ * @memberof control_snapshot
+ * @brief restore the state of the parameters
+ * 
+ * Modulators are only attached or detached where the slot differs, so the modulation graph is only recompiled
+ * if the routing changed. Nothing is allocated. An invalid snapshot is ignored.
+ * 
+ * @param snap the snapshot
+ * @param mgr the control manager
+ */
+void control_snapshot_apply(control_snapshot *snap, control_manager *mgr);
+
+/**
+ * @memberof control_snapshot
+ * @brief write a snapshot to a file
+ * 
+ * @param snap the snapshot
+ * @param mgr the control manager the snapshot belongs to, for the names
+ * @param path the path of the file
+ * @return int 1 on success, 0 if the snapshot is invalid or the file could not be written
+ */
+int control_snapshot_save(control_snapshot *snap, control_manager *mgr, const char *path);
+
+/**
+ * @memberof control_snapshot
+ * @brief read a snapshot from a file
+ * 
+ * Parameters that are not in the file keep their defaults. Unknown parameters and modulators are reported on stderr and skipped.
+ * 
+ * @param snap the snapshot
+ * @param mgr the control manager the snapshot belongs to, for the names
+ * @param path the path of the file
+ * @return int the number of unknown names or -1 if the file could not be read. The snapshot is only changed if it could be read
+ */
+int control_snapshot_load(control_snapshot *snap, control_manager *mgr, const char *path);
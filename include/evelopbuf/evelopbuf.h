@@ -1,8 +1,8 @@
 /**
  * @file evelopbuf.h
  * @author zeyu yang (zeyuuyang42@gmail.com)
- * @brief evelope and evelopbuf class, save & search & generate evelopes
- * @version 0.2
+ * @brief evelope and evelopbuf class, master tables & descriptors of evelopes
+ * @version 0.3
  * @date 2021-08-24
  * 
  * @copyright Copyright (c) 2021
@@ -19,23 +19,31 @@
 #include "util/util.h"
 #include "util/circbuf.h"
 
-#include "m_pd.h" // add for post function, remove this after debuging
+
+#define EVELOPE_NUMTYPES 4 /**< number of supported evelope types */
+
 
 /**
  * @struct evelope
  * @brief evelope class 
  * 
- * Store data of a evelope and its parameters. 
- * 4 types of evelope supported: parabolic, trapezoidal, raised_cosine_bell, no_evelope
+ * Describes the evelope of a single grain. 
+ * 4 types of evelope supported: no_evelope, parabolic, trapezoidal, raised_cosine_bell
  * Each of them with arbitrary length, amplitude, attacksamples or releasesamples 
  * 
+ * An evelope does not own any sample data. The attack is read from a normalized master table
+ * of its type, the release reads the same table backwards. The table position advances by a fixed
+ * increment per sample and is interpolated linearly, so any length can be rendered from the same table.
  */
 typedef struct {
-    float *data;         /**< The stored evelope data itself */
+    const float *table;  /**< normalized master table of the rising edge, @ref ENVELOPETABLESIZE + 2 entries */
     int type;            /**< The type of evelope */
     int length;          /**< The length of evelope */
+    float amplitude;     /**< The maximum amplitude of evelope */
     int attacksamples;   /**< The number of attack samples */
     int releasesamples;  /**< The number of release samples */
+    float attackinc;     /**< table increment per attack sample */
+    float releaseinc;    /**< table increment per release sample */
 } evelope, *p_evelope; /**< pointer to an envelope */
 
 
@@ -43,165 +51,68 @@ typedef struct {
  * @struct evelopbuf
  * @brief evelope buffer class
  * 
- * The evelope buffer class contains a data array, 
- * the buffer size and two indicators of front and rear of the queue.
+ * The evelope buffer class contains the master table of each evelope type.
+ * The tables are built once when the evelopbuf is created.
  */
 typedef struct {
-    p_evelope *data;  /**< The stored evelope structure itself */
-    int size;         /**< The buffer size */
-    int front;        /**< The indicator to the front position */
-    int rear;         /**< The indicator to the rear position */
-
+    float *tables[EVELOPE_NUMTYPES]; /**< normalized master table of each evelope type */
+    evelope current;                 /**< the evelope returned by the last call of evelopbuf_check_evelope */
 } evelopbuf;
 
 
 /**
  * @memberof evelope
- * @brief generate evelope  
+ * @brief initialize an evelope
  * 
- * This method creates a new evelope object
+ * This method describes an evelope of any length on top of a master table. Nothing is allocated
+ * and no sample of the evelope is computed.
+ * The parabolic evelope spans the whole length, the raised cosine and trapezoidal evelopes
+ * have an attack and a release. If they do not fit into the length, both get half of it.
  * 
- * @param ep the evelopbuf object to save generated evelope
+ * @param ep the evelope to be initialized
+ * @param eb the evelopbuf object containing the master tables
  * @param type the type of to the be generated evelope
  * @param length the length of the to be generated evelope
  * @param amplitude the maximum amplitude of the to be generated evelope
  * @param attacksamples the attack samples of the to be generated evelope
  * @param releasesamples the release samples of the to be generated evelope
  * 
- * @return evelope* a reference to the evelope object or `NULL` if failed
- */
-evelope *evelope_new(evelope* ep, int type, int length, float amplitude, int attacksamples, int releasesamples);
-
-/**
- * @memberof evelope
- * @brief free a evelope object
- * 
- * This method frees an evelope object
- * 
- * @param ep evelope object to be freed
- */
-void evelope_free(evelope* ep);
-
-/**
- * @memberof evelope
- * @brief create parabolic evelope
- * 
- * This method creates evelope using parabolic algorithm with adjustable parameters
- * 
- * @param ep the evelopbuf object to save generated evelope
- * @param type the type of to the be generated evelope
- * @param length the length of the to be generated evelope
- * @param amplitude the maximum amplitude of the to be generated evelope
- * 
- * @return evelope* a reference to the evelope object or `NULL` if failed
- */
-evelope *evelope_gen_parabolic(evelope* ep, int type, int length, float amplitude);
-
-/**
- * @memberof evelope
- * @brief create trapezoidal evelope 
- * 
- * This method creates evelope using trapezoidal algorithm with adjustable parameters
- * 
- * @param ep the evelopbuf object to save generated evelope
- * @param type the type of to the be generated evelope
- * @param length the length of the to be generated evelope
- * @param amplitude the maximum amplitude of the to be generated evelope
- * @param attacksamples the attack samples of the to be generated evelope
- * @param releasesamples the release samples of the to be generated evelope
- * 
- * @return evelope* a reference to the evelope object or `NULL` if failed
- */
-evelope *evelope_gen_trapezoidal(evelope* ep, int type, int length, float amplitude, int attacksamples, int releasesamples);
-
-/**
- * @memberof evelope
- * @brief create raised_cosine_bell evelope 
- * 
- * This method creates evelope using raised cosine bell algorithm with adjustable parameters
- * 
- * @param ep the evelopbuf object to save generated evelope
- * @param type the type of to the be generated evelope
- * @param length the length of the to be generated evelope
- * @param amplitude the maximum amplitude of the to be generated evelope
- * @param attacksamples the attack samples of the to be generated evelope
- * @param releasesamples the release samples of the to be generated evelope
- * 
- * @return evelope* a reference to the evelope object or `NULL` if failed
+ * @return evelope* a reference to the evelope object or `NULL` if the type is not supported
  */
-evelope *evelope_gen_raised_cosine_bell(evelope* ep, int type, int length, float amplitude, int attacksamples, int releasesamples);
+evelope *evelope_init(evelope *ep, evelopbuf *eb, int type, int length, float amplitude, int attacksamples, int releasesamples);
 
 /**
  * @memberof evelope
- * @brief create plane evelope
+ * @brief apply an evelope to a block of samples
  * 
- * This method creates plane evelope.
- * No evelope actually except amplitude adjustion.
+ * This method multiplies a block of samples with a part of the evelope, so that grains which
+ * are rendered block by block do not need a table that covers the whole grain.
  * 
- * @param ep the evelopbuf object to save generated evelope
- * @param type the type of the to be generated evelope
- * @param length the length of the to be generated evelope
- * @param amplitude the maximum amplitude of the to be generated evelope
- * 
- * @return evelope* a reference to the evelope object or `NULL` if failed
+ * @param ep the evelope describing the shape
+ * @param pos the position inside the evelope of the first sample
+ * @param dst the samples to be multiplied with the evelope
+ * @param n the number of samples
  */
-evelope *evelope_gen_no_evelope(evelope* ep, int type, int length, float amplitude);
+void evelope_apply(evelope* ep, int pos, float *dst, int n);
 
 
 /**
  * @memberof evelopbuf
- * @brief This method creates a new evelopbuf object
- * 
- * @param size size of evelope buffer
+ * @brief This method creates a new evelopbuf object and builds its master tables
  * 
+ * @param arena the arena the evelopbuf is allocated from
  * @return evelopbuf* a reference to the evelopbuf object or `NULL` if failed
  */
-evelopbuf *evelopbuf_new(int size);
-
-/**
- * @memberof evelopbuf
- * @brief This method frees an evelopbuf object
- * 
- * @param eb evelopbuf object to be freed
- */
-void evelopbuf_free(evelopbuf *eb);
-
-/**
- * @memberof evelopbuf
- * @brief add evelope object into evelopbuf
- * 
- * This method adds an evelope object to the rear of evelope buffer
- * If the buffer is full the front one will be removed
- * 
- * @param eb evelopbuf object to store evelope object
- * @param type the type of the to be added evelope
- * @param length the length of the to be added evelope
- * @param attacksamples attack time in samples
- * @param releasesamples release time in samples
- */ 
-void evelopbuf_add_evelope(evelopbuf *eb, int type, int length, int attacksamples, int releasesamples); // todo: add all parameters 
-
-/**
- * @memberof evelopbuf
- * @brief pops evelope object out of buffer
- * 
- * This method pop evelope object out of buffer when the buffer is not empty
- * 
- * @param eb evelopbuf object where evelope object will be popped
- * @param ep evelope object to store popped evelope object
- * 
- * @return evelope* a reference to the evelope object or `NULL` if failed
- */
-evelope *evelopbuf_pop_evelope(evelopbuf *eb, evelope* ep);
+evelopbuf *evelopbuf_new(mem_arena *arena);
 
 /**
  * @memberof evelopbuf
- * @brief checks all evelopes in evelopbuf
+ * @brief gets an evelope
  * 
- * This method checks if requested evelope in evelope buffer
- * Fetch and return it if found, else create it and return it
+ * This method describes the requested evelope in constant time without any allocation.
+ * The returned evelope is overwritten by the next call.
  * 
- * @param eb evelopbuf object to be checked
+ * @param eb evelopbuf object containing the master tables
  * @param type the type of the requested evelope
  * @param length the length of the requested evelope
  * @param attacksamples number for samples for envelope attack
@@ -210,42 +121,3 @@ evelope *evelopbuf_pop_evelope(evelopbuf *eb, evelope* ep);
  * @return evelope* a reference to the evelope object or `NULL` if failed
  */
 evelope *evelopbuf_check_evelope(evelopbuf *eb, int type, int length, int attacksamples, int releasesamples);
-
-/**
- * @memberof evelopbuf
- * @brief checks if the evelopbuf is full
- * 
- * This method checks if the evelopbuf is full
- * 
- * @param eb evelopbuf object to be checked
- * 
- * @return 0 or 1 indicates N or Y
- */
-int evelopbuf_is_full(evelopbuf *eb);
-
-/**
- * @memberof evelopbuf
- * @brief checks if the evelopbuf is empty
- * 
- * This method checks if the evelopbuf is empty
- * 
- * @param eb evelopbuf object to be checked
- * 
- * @return 0 or 1 indicates N or Y
- */
-int evelopbuf_is_empty(evelopbuf *eb);
-
-/**
- * @memberof evelopbuf
- * @brief gets number of evelopes in evelopbuf
- * 
- * This method gets the number of evelopes in evelope buffer
- * 
- * @param eb evelopbuf object to be checked
- * 
- * @return int the number of evelopes in evelope buffer
- */
-int evelopbuf_get_len(evelopbuf *eb);
-
-
-
@@ -16,15 +16,39 @@
 #include "scheduler/scheduler.h"
 #include "modulators/modulator_bank.h"
 #include "control/manager.h"
+#include "control/mailbox.h"
+#include "control/snapshot.h"
+#include "control/morph.h"
 #include "pitch/vocaldetector.h"
 
 #include "params.h"
 
 /**
  * @brief Main GOAT class
+ * 
+ * The engine can be used without Pure Data, see @ref goat_process and the `goat_param_` functions.
+ * The `goat~` external is a thin wrapper around it.
  */
 typedef struct goat {
     goat_config cfg; /**< configuration parameters */
+    double create_time; /**< seconds spent in @ref goat_new */
+    int locked; /**< whether the memory of the instance is locked. Only set if @ref goat_config.lock_memory was requested */
+
+    control_parameter **params; /**< all parameters, indexed by their id */
+    int numparams; /**< number of parameters */
+    control_mailbox *mailbox; /**< parameter updates from other threads, applied at the start of each block */
+    control_snapshot *snapshots[NUMPRESETSNAPSHOTS]; /**< preallocated slots for the whole control state */
+    int recallslot; /**< the snapshot slot of the last recall or -1, only used by the control thread */
+    unsigned int recallclear; /**< the number of the mailbox clear that requested the last recall */
+    atomic_uint recalled; /**< the number of the last mailbox clear the audio thread has carried out */
+    atomic_uint store; /**< bitmask of the snapshot slots to store at the start of the next block */
+    control_morph *morph; /**< glides between two snapshots with the parameter `morph.position` */
+    atomic_int morphrequest; /**< the pair of snapshot slots to morph between from the next block, -1 for none or -2 to stop */
+
+    float *blockin; /**< input samples collected for the next block by @ref goat_process */
+    float *blockout; /**< output of the last block, played back while the next block is collected */
+    size_t blockpos; /**< number of samples of the current block collected so far */
+
     modulator_bank *modbank; /**< the modulator bank */
     vocaldetector *vd; /**< the vocal detector */
     granular *gran;     /**< the granular instance */
@@ -38,13 +62,20 @@ typedef struct goat {
  * @memberof goat
  * @brief create a new goat instance
  * 
- * @return goat* the new goat instance
+ * All objects of the instance are allocated from a single arena, which is sized from the configuration.
+ * Only the parts of the buffers that are actually used are backed by memory, unless
+ * @ref goat_config.lock_memory is set. Then all buffers are faulted in and locked, so that the
+ * audio thread never waits for a page fault. To fit into the limit of locked memory, copied grains are
+ * then shorter than the delay line by default, see @ref goat_config.max_grain_size.
+ * 
+ * @param config the configuration. Unset fields are replaced with their defaults
+ * @return goat* the new goat instance or `NULL` if the creation failed
  */
 goat *goat_new(goat_config *config);
 
 /**
  * @memberof goat
- * @brief free a goat instance
+ * @brief free a goat instance and its arena
  * 
  * @param g the goat instance to free
  */
@@ -54,9 +85,236 @@ void goat_free(goat *g);
  * @memberof goat
  * @brief process a block of samples
  * 
+ * A reset requested with @ref goat_param_reset, a snapshot requested with @ref goat_snapshot_recall and
+ * parameter updates that were queued with @ref goat_param_queue and its siblings are applied first.
+ * 
  * @param g the goat instance
  * @param in the input samples
  * @param out the output samples
- * @param n the number of samples
+ * @param n the number of samples. This must be a valid block size for the vocal detector, see @ref is_valid_block_size
  */
 void goat_perform(goat *g, float *in, float *out, int n);
+
+/**
+ * @memberof goat
+ * @brief process any number of samples
+ * 
+ * The engine always runs in blocks of @ref goat_config.block_size samples. The input is collected into whole blocks,
+ * so the output is always delayed by one block, whatever the number of samples per call. The first block is silent.
+ * Callers that only ever pass whole blocks can call @ref goat_perform for each of them instead, without latency.
+ * 
+ * @param g the goat instance
+ * @param in the input samples. May be the same buffer as @a out
+ * @param out the output samples
+ * @param frames the number of samples
+ */
+void goat_process(goat *g, float *in, float *out, size_t frames);
+
+/**
+ * @memberof goat
+ * @brief get the number of parameters
+ * 
+ * Parameters are identified by an id from 0 to the number of parameters - 1. The ids of an instance never change.
+ * 
+ * @param g the goat instance
+ * @return int the number of parameters
+ */
+int goat_param_count(goat *g);
+
+/**
+ * @memberof goat
+ * @brief look up the id of a parameter
+ * 
+ * The lookup takes constant time, but hosts that automate parameters should look up the id once and keep it.
+ * 
+ * @param g the goat instance
+ * @param name the name of the parameter, e.g. `grainsize` or `lfo1.frequency`
+ * @return int the id or -1 if there is no such parameter
+ */
+int goat_param_id(goat *g, const char *name);
+
+/**
+ * @memberof goat
+ * @brief get the name of a parameter
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @return const char* the name or `NULL` if the id is out of range
+ */
+const char *goat_param_name(goat *g, int id);
+
+/**
+ * @memberof goat
+ * @brief set the value of a parameter before modulation
+ * 
+ * This must be called from the thread that processes the audio, otherwise use @ref goat_param_queue.
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @param value the new value
+ */
+void goat_param_set(goat *g, int id, float value);
+
+/**
+ * @memberof goat
+ * @brief get the current value of a parameter including its modulation
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @return float the value or 0 if the id is out of range
+ */
+float goat_param_get(goat *g, int id);
+
+/**
+ * @memberof goat
+ * @brief set the value of a parameter before modulation from any thread
+ * 
+ * The value is applied at the start of the next block. If a parameter is queued several times before that,
+ * only the last value is applied.
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @param value the new value
+ */
+void goat_param_queue(goat *g, int id, float value);
+
+/**
+ * @memberof goat
+ * @brief set the values of several parameters from any thread
+ * 
+ * Like @ref goat_param_queue, but all values are applied in the same block.
+ * 
+ * @param g the goat instance
+ * @param ids the ids of the parameters
+ * @param values the new values
+ * @param count the number of parameters
+ */
+void goat_param_queue_list(goat *g, const int *ids, const float *values, int count);
+
+/**
+ * @memberof goat
+ * @brief attach a modulator to a slot of a parameter from any thread
+ * 
+ * Changes to the modulation slots are applied at the start of the next block, in the order they were queued.
+ * Only the thread that queues values may queue them. Attaching a modulator that is already attached has no effect.
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @param slot the slot from 0 to @ref CONTROL_NUM_SLOTS - 1
+ * @param modname the name of the modulator, e.g. `lfo1`
+ * @return int 1 on success, 0 if an argument is invalid or too many changes are waiting for the next block
+ */
+int goat_param_queue_attach(goat *g, int id, int slot, const char *modname);
+
+/**
+ * @memberof goat
+ * @brief detach the modulator from a slot of a parameter from any thread
+ * 
+ * Like @ref goat_param_queue_attach.
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @param slot the slot
+ * @return int 1 on success, 0 if an argument is invalid or too many changes are waiting for the next block
+ */
+int goat_param_queue_detach(goat *g, int id, int slot);
+
+/**
+ * @memberof goat
+ * @brief set the modulation amount of a slot of a parameter from any thread
+ * 
+ * Like @ref goat_param_queue_attach.
+ * 
+ * @param g the goat instance
+ * @param id the id of the parameter
+ * @param slot the slot
+ * @param amount the new amount
+ * @return int 1 on success, 0 if an argument is invalid or too many changes are waiting for the next block
+ */
+int goat_param_queue_amount(goat *g, int id, int slot, float amount);
+
+/**
+ * @memberof goat
+ * @brief reset all parameters to their defaults and detach all modulators at the start of the next block
+ * 
+ * Updates that were queued before are discarded, those queued afterwards are applied after the reset.
+ * Must be called from the thread that queues the updates.
+ * 
+ * @param g the goat instance
+ */
+void goat_param_reset(goat *g);
+
+/**
+ * @memberof goat
+ * @brief store the offsets, modulators and amounts of all parameters in a snapshot slot
+ * 
+ * The state belongs to the audio thread, so the snapshot is taken there at the start of the next block,
+ * before a reset, recall or morph requested in the same block. Values that were queued but not applied yet
+ * are stored as well. Until then the slot can not be recalled, morphed, read or written.
+ * Snapshots must be stored, read, written and recalled from the same thread.
+ * 
+ * @param g the goat instance
+ * @param slot the slot from 0 to @ref NUMPRESETSNAPSHOTS - 1
+ * @return int 1 on success, 0 if the slot is out of range
+ */
+int goat_snapshot_store(goat *g, int slot);
+
+/**
+ * @memberof goat
+ * @brief switch to the state of a snapshot slot at the start of the next block
+ * 
+ * All parameters change in the same block and nothing is allocated. Updates that were queued before are discarded,
+ * those queued afterwards are applied on top of the snapshot. A running morph is stopped.
+ * This need not be the audio thread, but it must be the thread that stores the snapshots and queues the updates.
+ * The slot can not be read from a file until it has been applied.
+ * 
+ * @param g the goat instance
+ * @param slot the slot
+ * @return int 1 on success, 0 if the slot is out of range, empty or stored in the next block
+ */
+int goat_snapshot_recall(goat *g, int slot);
+
+/**
+ * @memberof goat
+ * @brief read a snapshot file into a slot
+ * 
+ * This fails while a store, recall or morph of the slot waits for the next block, as the audio thread accesses it then.
+ * 
+ * @param g the goat instance
+ * @param slot the slot
+ * @param path the path of the file, see @ref snapshot.h for the format
+ * @return int the number of unknown parameters and modulators in the file or -1 if it could not be read
+ */
+int goat_snapshot_read(goat *g, int slot, const char *path);
+
+/**
+ * @memberof goat
+ * @brief write a snapshot slot to a file
+ * 
+ * @param g the goat instance
+ * @param slot the slot
+ * @param path the path of the file
+ * @return int 1 on success, 0 if the slot is empty, is stored in the next block or the file could not be written
+ */
+int goat_snapshot_write(goat *g, int slot, const char *path);
+
+/**
+ * @memberof goat
+ * @brief morph between two snapshot slots with the parameter `morph.position`, starting with the next block
+ * 
+ * The slots are copied when the morph starts, so they can be stored again from the next block on. See @ref morph.h.
+ * 
+ * @param g the goat instance
+ * @param from the slot at position 0
+ * @param to the slot at position 1
+ * @return int 1 on success, 0 if a slot is out of range or empty
+ */
+int goat_morph(goat *g, int from, int to);
+
+/**
+ * @memberof goat
+ * @brief stop morphing with the next block, the parameters keep their current state
+ * 
+ * @param g the goat instance
+ */
+void goat_morph_stop(goat *g);
@@ -13,6 +13,7 @@
 
 #include <stddef.h>
 #include "control/manager.h"
+#include "util/mem.h"
 
 
 /**
@@ -22,5 +23,11 @@
 typedef struct {
     size_t sample_rate; /**< audio samples per second */
     size_t block_size; /**< size of one audio block. The vector size n of the perform method might be smaller!! */
+    int num_voices; /**< maximum number of simultaneously playing grains. 0 selects the default */
+    size_t delay_size; /**< length of the delay line in samples, rounded up to a power of two. 0 selects the default */
+    int delay_format; /**< @ref circbuf_format the delay line stores its samples in */
+    size_t max_grain_size; /**< maximum length of a grain that is copied out of the delay line in samples, at most the delay line. 0 selects the default */
+    int lock_memory; /**< whether to prefault and lock all buffers of the instance on creation */
     control_manager *mgr; /**< global control manager */
+    mem_arena *arena; /**< the arena all objects of the instance are allocated from */
 } goat_config;
@@ -28,6 +28,7 @@ typedef struct {
     t_outlet *dataout; /**< main data outlet */
 
     goat *g; /**< pointer to the goat object */
+    t_canvas *canvas; /**< the canvas the object was created on, file names are relative to its directory */
 
 } goat_tilde;
 
@@ -36,9 +37,14 @@ typedef struct {
  * @memberof goat_tilde
  * @brief creates a new goat_tilde object
  * 
+ * @param voices the maximum number of simultaneously playing grains. 0 selects the default
+ * @param delay the minimum length of the delay line in seconds. It is rounded up to a power of two samples, 0 selects the default
+ * @param format the sample format of the delay line: 0 float, 1 16 bit integer, 2 16 bit half float
+ * @param lock 1 to prefault and lock all buffers in memory, so that the dsp never takes a page fault
+ * @param grainsize the maximum length of a copied grain in seconds, 0 for the default
  * @return void* a pointer to the new object or `NULL` if the creation failed
  */
-void *goat_tilde_new(void);
+void *goat_tilde_new(t_floatarg voices, t_floatarg delay, t_floatarg format, t_floatarg lock, t_floatarg grainsize);
 
 /**
  * @memberof goat_tilde
@@ -61,12 +67,106 @@ void goat_tilde_param_get(goat_tilde *x, t_symbol *paramname);
  * @memberof goat_tilde
  * @brief updates a parameter's value
  * 
+ * The value is applied at the start of the next dsp block. If a parameter is set several times before that,
+ * only the last value is applied.
+ * 
  * @param x the goat object
  * @param paramname the name of the parameter to be updated
  * @param value the offset value to be updated
  */
 void goat_tilde_param_set(goat_tilde *x, t_symbol *paramname, t_float value);
 
+/**
+ * @memberof goat_tilde
+ * @brief updates the values of several parameters in the same block
+ * 
+ * The arguments are pairs of a parameter, given by its name or id, and its value,
+ * e.g. `param-set-list grainsize 0.2 grainpitch 7`.
+ * 
+ * @param x the goat object
+ * @param s the selector, unused
+ * @param argc the number of atoms
+ * @param argv the pairs of parameter and value
+ */
+void goat_tilde_param_set_list(goat_tilde *x, t_symbol *s, int argc, t_atom *argv);
+
+/**
+ * @memberof goat_tilde
+ * @brief updates a parameter's value addressed by its id
+ * 
+ * This skips the lookup by name, use @ref goat_tilde_param_id to find the ids.
+ * 
+ * @param x the goat object
+ * @param id the id of the parameter to be updated
+ * @param value the offset value to be updated
+ */
+void goat_tilde_param_set_id(goat_tilde *x, t_float id, t_float value);
+
+/**
+ * @memberof goat_tilde
+ * @brief stores the state of all parameters in a snapshot slot
+ * 
+ * @param x the goat object
+ * @param slot the slot
+ */
+void goat_tilde_snapshot_store(goat_tilde *x, t_float slot);
+
+/**
+ * @memberof goat_tilde
+ * @brief switches all parameters to a snapshot slot in the next dsp block
+ * 
+ * @param x the goat object
+ * @param slot the slot
+ */
+void goat_tilde_snapshot_recall(goat_tilde *x, t_float slot);
+
+/**
+ * @memberof goat_tilde
+ * @brief reads a snapshot file into a slot
+ * 
+ * @param x the goat object
+ * @param slot the slot
+ * @param filename the file, relative to the directory of the patch
+ */
+void goat_tilde_snapshot_read(goat_tilde *x, t_float slot, t_symbol *filename);
+
+/**
+ * @memberof goat_tilde
+ * @brief writes a snapshot slot to a file
+ * 
+ * @param x the goat object
+ * @param slot the slot
+ * @param filename the file, relative to the directory of the patch
+ */
+void goat_tilde_snapshot_write(goat_tilde *x, t_float slot, t_symbol *filename);
+
+/**
+ * @memberof goat_tilde
+ * @brief morphs between two snapshot slots with the parameter `morph.position`
+ * 
+ * @param x the goat object
+ * @param from the slot at position 0
+ * @param to the slot at position 1
+ */
+void goat_tilde_morph(goat_tilde *x, t_float from, t_float to);
+
+/**
+ * @memberof goat_tilde
+ * @brief stops morphing, the parameters keep their current state
+ * 
+ * @param x the goat object
+ */
+void goat_tilde_morph_stop(goat_tilde *x);
+
+/**
+ * @memberof goat_tilde
+ * @brief get the id of a single or all parameters for @ref goat_tilde_param_set_id
+ * 
+ * @param x the goat object
+ * @param paramname the name of the parameter. If `NULL` or empty, the ids of all parameters are returned
+ */
+void goat_tilde_param_id(goat_tilde *x, t_symbol *paramname);
+
 /**
  * @memberof goat_tilde
  * @brief updates a parameter slot's amount of influence
@@ -81,7 +181,8 @@ void goat_tilde_param_amount(goat_tilde *x, t_symbol *paramname, t_float fslot,
 /**
  * @memberof goat_tilde
  * @brief connects a modulator to a parameter.
- * Any other modulator on that slot will be disconnected.
+ * Any other modulator on that slot will be disconnected. Like all changes to the slots,
+ * this takes effect at the start of the next dsp block.
  * Due to a bug in the windows version of Pure Data, this method had to be implemented using
  * A_GIMME instead of the parameter list A_SYMBOL, A_FLOAT, A_SYMBOL.
  * 
@@ -112,7 +213,19 @@ void goat_tilde_param_post(goat_tilde *x);
 
 /**
  * @memberof goat_tilde
- * @brief resets all the parameters to default and detaches modulators
+ * @brief posts the instance and voice pool statistics to the debug console
+ * 
+ * The instance statistics contain the time spent in creating the instance and the size of its arena.
+ * In debug builds this also includes the number of heap calls, which must not change while
+ * the dsp is running.
+ * 
+ * @param x the goat object
+ */
+void goat_tilde_stats_post(goat_tilde *x);
+
+/**
+ * @memberof goat_tilde
+ * @brief resets all the parameters to default and detaches modulators at the start of the next dsp block
  * 
  * @param x the goat object
  */
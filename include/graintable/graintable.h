@@ -12,11 +12,11 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdint.h>
 #include "util/mem.h"
 #include "util/util.h"
 #include "util/circbuf.h"
-
-#include "m_pd.h" // add for post function, remove this after debuging
+#include "pitch/pitchtimeline.h"
 
 #include "params.h"
 
@@ -29,7 +29,7 @@
 typedef struct {
     // basic features of a grain
     circbuf *cb; /**< pointer to the buffer contains data to be sampled */
-    circbuf *pb; /**< pointer to the buffer containing the pitch data */
+    pitchtimeline *pt; /**< pointer to the timeline containing the pitch data */
     size_t gb_size; /**< size of the grain buffer */
 
     float position;  /**< absolute start position of a grain at buffer */
@@ -37,21 +37,37 @@ typedef struct {
     float delay;     /**< delay of a grain in samples */
     float speed;     /**< the speed at which the grain should be read */
     size_t timeout;    /**< statue mark to tell if a grain still valid. suit for DelayLine grain source */
-    size_t lifetime;   /**< elapsed samples since the grain's creation */
+    uint64_t birth;    /**< engine sample clock at the grain's creation */
     int  evelope;    /**< type of evelope to be applied on this grain */
 } grain;
 
 
+/**
+ * @struct graintable_entry
+ * @related graintable
+ * @brief entry of the graintable's heap
+ */
+typedef struct {
+    double due; /**< engine sample clock at which the grain should be synthesized */
+    int slot;   /**< index of the grain in @ref graintable.data */
+} graintable_entry;
+
 /**
  * @struct graintable
  * @brief data structure stores grain objects
+ * 
+ * The grains are kept in a binary min-heap ordered by their due time, so a grain with a long delay
+ * does not hold back the grains behind it. The grains themselves stay in fixed slots, only the small
+ * heap entries are moved around.
  */
 typedef struct{
-    grain *data;     /**< The stored data itself */
-    int size;        /**< The buffer size */
-    int front;       /**< The indicator to the front position */
-    int rear;        /**< The indicator to the rear position */
-
+    grain *data;             /**< The stored data itself, indexed by slot */
+    graintable_entry *heap;  /**< min-heap of the pending grains */
+    int *freeslots;          /**< stack of unused slots */
+    int size;                /**< The maximum number of grains */
+    int len;                 /**< The number of pending grains */
+    int numfree;             /**< The number of unused slots */
+    size_t numinvalid;       /**< The number of grains discarded because of an invalid duration */
 } graintable; 
 
 
@@ -63,37 +79,47 @@ typedef struct{
  * 
  * @param gn the grain to be initialized. Must not be `NULL`
  * @param cb the circle buffer object as the source of grains
- * @param pb the pitch buffer
+ * @param pt the pitch timeline
  * @param position absolute start position of a grain at buffer
  * @param duration length of a grain in sample
  * @param delay delay of a grain in samples
  * @param speed the speed at which the grain should be read
  * @param max_timeout time in samples when the grain can be removed
  * @param evelope type of evelope to be applied on this grain
+ * @param birth engine sample clock at the grain's creation
  * 
  * @return grain* a reference to the grain object
  */
-grain *grain_init(grain *gn, circbuf *cb, circbuf *pb, float position, float duration, float delay, float speed, size_t max_timeout, int evelope);
+grain *grain_init(grain *gn, circbuf *cb, pitchtimeline *pt, float position, float duration, float delay, float speed, size_t max_timeout, int evelope, uint64_t birth);
 
 /**
  * @memberof grain
- * @brief post all the features of a grain in pd-console for debugging
+ * @brief get the sample offset inside the current block where the grain's delay has elapsed
  * 
- * @param gn the grain object to be posted
+ * The grain does not need to be updated while it waits, its due time is compared against the engine clock.
+ * 
+ * @param gn the grain
+ * @param now engine sample clock at the start of the current block
+ * @return float the offset in samples. Values of at least the block size mean that the grain is not due yet
  */
-void grain_post_feature(grain *gn);
+float grain_get_start(grain *gn, uint64_t now);
 
 /**
  * @memberof grain
- * @brief update timeout parameter at each dsp circle
+ * @brief get the engine sample clock at which the grain's delay has elapsed
  * 
- * Due to the nature of delayline, a selected grain in the buffer would be overwritten after a period of time
- * Update timeout parameter at each dsp circle could reduce artifical effect caused by uncasual selection
+ * @param gn the grain
+ * @return double the due time in samples
+ */
+double grain_get_due(grain *gn);
+
+/**
+ * @memberof grain
+ * @brief post all the features of a grain in pd-console for debugging
  * 
- * @param gn the grain object to be updated
- * @param n number of new samples stored in audio buffer
+ * @param gn the grain object to be posted
  */
-void grain_update_lifetime(grain *gn, int n);
+void grain_post_feature(grain *gn);
 
 /**
  * @memberof graintable
@@ -103,21 +129,12 @@ void grain_update_lifetime(grain *gn, int n);
  * Graintable stores all grains object using queue as data structure
  * Not a strict queue, because check grains from middle still supported
  * 
- * @param size the size of graintable
+ * @param arena the arena the graintable is allocated from
+ * @param size the maximum number of grains
  * 
  * @return graintable* a reference to the graintable object or `NULL` if failed
  */
-graintable *graintable_new(int size);
-
-/**
- * @memberof graintable
- * @brief frees a graintable object
- * 
- * This method frees a graintable object
- * 
- * @param gt the graintable object to be freed
- */
-void graintable_free(graintable *gt);
+graintable *graintable_new(mem_arena *arena, int size);
 
 /**
  * @memberof graintable
@@ -125,24 +142,27 @@ void graintable_free(graintable *gt);
  * 
  * This method adds a new grain object into graintable
  * The new grain is sampled according to the circle buffer's 
- * ReadTap position and parameters from scheduler
+ * ReadTap position and parameters from scheduler. It is sorted into the heap in O(log n)
+ * Grains that are too short or do not fit into the circle buffer are discarded silently and counted
+ * in @ref graintable.numinvalid, as this runs on the audio thread.
  * 
  * @param gt the graintable object to store the new grain
  * @param cb the circle buffer to sample grain
- * @param pb the global pitch buffer
+ * @param pt the global pitch timeline
  * @param position absolute start position of a grain at buffer
  * @param duration the size of grain
  * @param delay the delay of the grain
  * @param speed the speed of the grain
  * @param evelope the tyoe of evelope of grain
+ * @param birth the engine sample clock at the grain's creation
  */
-void graintable_add_grain(graintable *gt, circbuf *cb, circbuf *pb, float position, float duration, float delay, float speed, int evelope);
+void graintable_add_grain(graintable *gt, circbuf *cb, pitchtimeline *pt, float position, float duration, float delay, float speed, int evelope, uint64_t birth);
 
 /**
  * @memberof graintable
- * @brief return the front grain out of graintable without removing it
+ * @brief return the grain that is due next without removing it
  * 
- * This method returns the front grain object out of graintable when the graintable is not empty
+ * This method returns the grain with the earliest due time in O(1) when the graintable is not empty
  * 
  * @param gt graintable object where grain object will be returned
  * 
@@ -152,9 +172,10 @@ grain *graintable_peek_grain(graintable *gt);
 
 /**
  * @memberof graintable
- * @brief pops the front grain out of graintable
+ * @brief pops the grain that is due next out of graintable
  * 
- * This method pop the front grain object out of graintable when the graintable is not empty
+ * This method removes the grain with the earliest due time in O(log n) when the graintable is not empty.
+ * The returned grain stays valid until the next grain is added
  * 
  * @param gt graintable object where grain object will be popped
  * 
@@ -207,17 +228,6 @@ int graintable_is_empty(graintable *gt);
  */
 int graintable_get_len(graintable *gt);
 
-/**
- * @memberof graintable
- * @brief update all timeout of grains
- * 
- * This method updates all timeout parameter of grains in the graintable
- * 
- * @param gt graintable object that stores grains 
- * @param n number of new samples stored in audio buffer
- */
-void graintable_update_lifetime(graintable *gt, int n);
-
 /**
  * @memberof graintable
  * @brief print information of all grains in graintable
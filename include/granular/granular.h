@@ -18,6 +18,8 @@
 #include "evelopbuf/evelopbuf.h"
 #include "synthesizer/synthesizer.h"
 #include "pitch/vocaldetector.h"
+#include "pitch/pitchtimeline.h"
+#include "goat_config.h"
 
 
 /**
@@ -29,24 +31,28 @@
  */
 typedef struct {
     circbuf *buffer;     /**< circular buffer used to sample the grains */
-    circbuf *pitchbuffer; /**< circular buffer used to store the pitch values */
+    pitchtimeline *pitch; /**< control rate history of the detected pitch, in sync with the buffer */
     graintable *grains;  /**< queue used to store the registed grains' information */
     evelopbuf *evelopes;  /**< buffer to store all generated evelops */
     synthesizer *synth;   /**< arrange and combine grains to get final output stream */ 
+    uint64_t clock;       /**< engine sample clock, the number of samples processed before the current block */
 } granular;
 
 /**
  * @memberof granular
  * @brief create a new granular object
  * 
+ * @param cfg the global configuration
  * @return granular* a reference to the allocated granular object or `NULL` if the allocation failed
  */
-granular *granular_new(void);
+granular *granular_new(goat_config *cfg);
 
 /**
  * @memberof granular
  * @brief frees an existing granular object
  * 
+ * Only the mapping of the delay line is released, the object itself belongs to the arena.
+ * 
  * @param g the granular instance to be freed. Must not be `NULL`.
  */
 void granular_free(granular *g);
@@ -48,14 +48,6 @@ typedef struct {
  */
 low_frequency_oscillator *lfo_new(goat_config *cfg, const char *name);
 
-/**
- * @memberof low_frequency_oscillator
- * @brief free a lfo modulator.
- * 
- * @param lfo a reference to the lfo to free
- */
-void lfo_free(low_frequency_oscillator *lfo);
-
 /**
  * @memberof low_frequency_oscillator
  * @brief run the lfo modulator for a block of samples
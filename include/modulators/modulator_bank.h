@@ -43,11 +43,3 @@ typedef struct modulator_bank {
  * @return modulator_bank* a pointer to the new modulator bank or NULL if the allocation failed
  */
 modulator_bank *modulator_bank_new(goat_config *cfg, vocaldetector *vd);
-
-/**
- * @memberof modulator_bank
- * @brief frees an existing modulator bank
- * 
- * @param bank the modulator bank to be freed
- */
-void modulator_bank_free(modulator_bank *bank);
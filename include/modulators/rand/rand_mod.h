@@ -12,12 +12,16 @@
 #pragma once
 #include "control/manager.h"
 #include "goat_config.h"
+#include "util/rng.h"
 #include <stdlib.h>
 #include <math.h>
 
 /**
  * @struct rand_mod
  * @brief random number generator for modulation
+ * 
+ * Each modulator draws from its own generator. With a seed parameter of 0 it is seeded differently for
+ * every instance, any other seed makes the sequence reproducible.
  */
 typedef struct {
     control_modulator super; /**< the modulator super class instance */
@@ -26,8 +30,10 @@ typedef struct {
     control_parameter   *mu; /**< Expectation value;*/
     control_parameter   *sigma; /**< standard deviation*/
     control_parameter   *freq; /**< frequency of new random numbers*/
+    control_parameter   *seed; /**< seed of the generator, 0 for a different sequence every time*/
     float   rand_num; /**< a normal distributed random number*/
-    int     seed; /**< Seed for the standard rand() function; needed for receiving different random numbers every time*/
+    rng     gen; /**< the generator of this modulator*/
+    int     appliedseed; /**< the seed parameter the generator was last seeded with*/
     float   time; /**< time passed since last generated random number*/
 } rand_mod;
 
@@ -42,14 +48,6 @@ typedef struct {
  */
 rand_mod *rand_mod_new(goat_config *cfg, const char *name);
 
-/**
- * @memberof rand_mod
- * @brief free a random modulator.
- * 
- * @param rm a reference to the random modulator to free
- */
-void rand_mod_free(rand_mod *rm);
-
 /**
  * @memberof rand_mod
  * @brief run the random modulator for a block of samples
@@ -62,18 +60,20 @@ void rand_mod_perform(rand_mod *rm, float *in, int n);
 
 /**
  * @memberof rand_mod
- * @brief set the seed for random number generation.
- * @details without setting the seed one would get the same random numbers within a second
- * So this is needed for receiving different random numbers, even when it is called several times a second
+ * @brief seed the generator of the modulator
+ * @details The name of the modulator is mixed into the seed, so that modulators with the same seed
+ * still produce different sequences. A seed of 0 mixes in the time and the address of the modulator instead.
  * 
  * @param rm a reference to the random modulator
+ * @param seed the seed or 0 for a different sequence every time
  */
-void rand_setSeed(rand_mod *rm);
+void rand_mod_seed(rand_mod *rm, int seed);
 
 /**
  * @memberof rand_mod
- * @brief Leva algorithm for normal distributed random numbers
- * @see https://dl.acm.org/doi/10.1145/138351.138364
+ * @brief normal distributed random numbers
+ * @details The standard normal variate of the ziggurat sampler is scaled by half the variation, like the values of the
+ * Leva algorithm that was used before, so existing presets keep their character.
  * 
  * @param rm a reference to the ramdom modulator; contains expectation value and standard deviation
  * @returns a float number out of a normal distribution
@@ -40,14 +40,6 @@ typedef struct {
  */
 vocaldetector_mod *vdmod_new(goat_config *cfg, vocaldetector *vd, const char *name);
 
-/**
- * @memberof vocaldetector_mod
- * @brief delete an existing vocaldetector_mod instance
- * 
- * @param vdmod the instance to be deleted
- */
-void vdmod_free(vocaldetector_mod *vdmod);
-
 /**
  * @memberof vocaldetector_mod
  * @brief update the vocaldetector modulator.
@@ -10,8 +10,18 @@
  */
 #pragma once
 
-#define MAXTABLESIZE 4069 /**< maximum table size */
-#define DELAYLINESIZE 262144  /**< delay line size, 262144 equal to 2^18, close to 6s under sample rate 44100 */
-#define NUMACTIVEGRAIN 20 /**< maximum number of active grains */
-#define ENVELOPEBUFSIZE 12  /**< size of the buffer for the envelopment of the grain */
+#define MAXTABLESIZE 4096 /**< maximum number of grains waiting in the graintable */
+#define MAXGRAINRELEASE 64 /**< maximum number of grains released from the graintable per block */
+#define DELAYLINESIZE 262144  /**< default delay line size, 262144 equal to 2^18, close to 6s under sample rate 44100 */
+#define MINDELAYLINESIZE 4096 /**< lower limit for the delay line size set with the creation argument of goat~ */
+#define MAXDELAYLINESIZE 16777216 /**< upper limit for the delay line size, 2^24 or about 6 minutes under sample rate 44100 */
+#define PITCHHOPSIZE 64 /**< number of samples that share one entry of the pitch timeline */
+#define NUMACTIVEGRAIN 20 /**< default maximum number of active grains, can be changed with the creation argument of goat~ */
+#define MAXACTIVEGRAIN 65536 /**< upper limit for the number of active grains */
+#define NUMSNAPSHOTGRAIN 20 /**< number of active grains that can be copied out of the delay line at the same time */
+#define MINSNAPSHOTGRAINSIZE 4096 /**< lower limit for the length of copied grains in samples */
+#define ENVELOPETABLESIZE 1024  /**< resolution of the master table of each evelope shape */
+#define BLOCKSIZE 64 /**< default number of samples the engine processes at once */
+#define NUMPRESETSNAPSHOTS 16 /**< number of snapshot slots of each instance for instant preset switching */
+#define ARENABASESIZE 1048576 /**< memory reserved in the arena of each instance for small objects, on top of the buffers */
 #define PI M_PI /**< alternate pi definition */
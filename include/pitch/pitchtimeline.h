@@ -0,0 +1,74 @@
+/**
+ * @file pitchtimeline.h
+ * @author Amon Benson (amonkbenson@gmail.com)
+ * @brief control rate history of the detected pitch
+ * @version 0.1
+ * @date 2021-09-20
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "util/mem.h"
+
+
+/**
+ * @struct pitchtimeline
+ * @brief pitch history that runs in sync with the delay line
+ * 
+ * The detected pitch only changes once per detection, so the timeline does not store a value per sample.
+ * Instead, the delay line is divided into hops and every hop stores the running sum of the voiced pitch
+ * and the running number of voiced samples up to its end. The mean pitch over any range of the delay line
+ * is the difference of two entries, so it takes constant time regardless of the length of the range.
+ */
+typedef struct {
+    double *pitchsum;   /**< running sum of the voiced pitch at the end of each hop */
+    double *voicedsum;  /**< running number of voiced samples at the end of each hop */
+    size_t size;        /**< number of hops, a power of two */
+    size_t hop;         /**< number of samples per hop, a power of two */
+    size_t length;      /**< number of samples covered by the timeline, equals the delay line size */
+    size_t position;    /**< sample position of the write head, in sync with the delay line's write tap */
+
+    double pitchtotal;  /**< running sum of the voiced pitch */
+    double voicedtotal; /**< running number of voiced samples */
+} pitchtimeline;
+
+
+/**
+ * @memberof pitchtimeline
+ * @brief create a new pitch timeline
+ * 
+ * @param arena the arena the timeline is allocated from
+ * @param length number of samples to cover. This must be a power of two
+ * @param hop number of samples per entry. This must be a power of two not larger than @a length
+ * @return pitchtimeline* a reference to the allocated timeline or `NULL` if the allocation failed
+ */
+pitchtimeline *pitchtimeline_new(mem_arena *arena, size_t length, size_t hop);
+
+/**
+ * @memberof pitchtimeline
+ * @brief append @a n samples with the same pitch
+ * 
+ * The cost is proportional to the number of hops touched, not to the number of samples.
+ * 
+ * @param pt the timeline to write to
+ * @param frequency the detected pitch in Hz. Values <= 0 mark unvoiced samples
+ * @param n the number of samples
+ */
+void pitchtimeline_write(pitchtimeline *pt, float frequency, size_t n);
+
+/**
+ * @memberof pitchtimeline
+ * @brief mean of the voiced pitch in a range of the delay line in O(1)
+ * 
+ * The range is rounded outwards to whole hops. Parts of the range that have not been written yet are ignored.
+ * 
+ * @param pt the timeline to read from
+ * @param start delay line position of the first sample
+ * @param n the number of samples
+ * @return float the mean pitch in Hz or 0 if the range does not contain any voiced samples
+ */
+float pitchtimeline_mean(pitchtimeline *pt, size_t start, size_t n);
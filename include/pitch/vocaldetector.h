@@ -13,6 +13,7 @@
 
 #include <stddef.h>
 #include <math.h>
+#include "util/mem.h"
 #include "util/util.h"
 
 
@@ -72,18 +73,11 @@ typedef struct {
  * @memberof vocaldetector
  * @brief create a new vocal detector
  * 
+ * @param arena the arena the vocal detector is allocated from
  * @param sample_rate the sample rate of the audio data
  * @return vocaldetector* the new vocal detector
  */
-vocaldetector *vd_new(size_t sample_rate);
-
-/**
- * @memberof vocaldetector
- * @brief free a vocal detector
- * 
- * @param vd the vocal detector to free
- */
-void vd_free(vocaldetector *vd);
+vocaldetector *vd_new(mem_arena *arena, size_t sample_rate);
 
 
 /**
@@ -24,10 +24,12 @@
 #include "util/mem.h"
 #include "util/util.h"
 
-#include "m_pd.h" // add for post function, remove this after debuging
-
 #include "params.h"
 #include "goat_config.h"
+#include "util/circbuf.h"
+
+
+#define SCHEDULER_MAX_ONSETS 64 /**< maximum number of grain onsets per block */
 
 
 /**
@@ -48,10 +50,13 @@ typedef struct {
     control_parameter *attacktime;  /**< attack time for envelope*/
     control_parameter *releasetime; /**< release time for envelope*/
     control_parameter *relativepitch; /**< flag if relative pitch should be used */
+    control_parameter *streaming; /**< flag if grains should be streamed from the delay line instead of being copied */
+    control_parameter *quality; /**< interpolation kernel used to read pitched grains, see @ref circbuf_interp */
 
     // configs that changed at each dsp routine
-    size_t lastfetch; /**< the number of samples since the last grain was fetched */
-    int dofetch; /**< flag if we should sample a new grain */
+    float nextonset; /**< fractional number of samples from the start of the block until the next grain onset */
+    int onsets[SCHEDULER_MAX_ONSETS]; /**< sample offsets inside the current block where new grains should be sampled */
+    int numonsets; /**< the number of grain onsets in the current block */
 
     // // advance user adjustable configs 
     // int getpitch;       /**< enable the pitch detection or not, 0 for disable */
@@ -74,16 +79,6 @@ typedef struct {
  */
 scheduler *scheduler_new(goat_config *cfg);
 
-/**
- * @memberof scheduler
- * @brief frees a scheduler object
- * 
- * This method frees a scheduler object
- * 
- * @param sd the scheduler object to be freed
- */
-void scheduler_free(scheduler *sd);
-
 /**
  * @memberof scheduler
  * @brief get the next interonset 
@@ -103,7 +98,10 @@ int scheduler_get_next_interonset(int max, int min, int slot);
  * @brief update configs at each dsp routin
  * 
  * This method updates the configs at each dsp routine
- * Configs could change automaticly or under user's adjustion
+ * Configs could change automaticly or under user's adjustion.
+ * The distance between two grains is accumulated with sub-sample precision and every onset that
+ * falls into the block is stored in @ref scheduler.onsets, so the grain density does not depend on the block size.
+ * The distance after each onset is computed from the parameters at the onset's sample, see @ref param_at.
  * 
  * @param sd the scheduler object to be processed
  * @param n the number of samples processed
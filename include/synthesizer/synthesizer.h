@@ -13,91 +13,175 @@
 
 #include <stdio.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "util/mem.h"
 #include "util/util.h"
 
-#include "m_pd.h" // add for post function, remove this after debuging
-
 #include "params.h"
 #include "util/circbuf.h"
 #include "graintable/graintable.h"
 #include "evelopbuf/evelopbuf.h"
 
+
+#define SYNTH_SCRATCH_SIZE 256 /**< number of samples a streamed voice renders at once */
+#define SYNTH_COPY_BUDGET 4096 /**< number of samples per block that copied voices may read ahead of what is required */
+
 /**
- * @struct activategrain
- * @brief activategrain class contains data of activate grain
- * 
- * The activategrain class contains samples and basic parameters of an activate grain 
- * And other behaviour controll parameters
+ * @def SYNTH_IS_LIVE(syn, v)
+ * @brief checks if the voice @a v of the synthesizer @a syn is currently playing
  */
-typedef struct {
-    grain origin;  /**< the original grain */
-    float *data;   /**< The stored activate grain data itself */
-    int pos;       /**< The position to read this activate grain */
-    int length;    /**< The position to read this activate grain */
-    int repeat;    /**< Wether use this grain repeatly */
-} activategrain, *p_activategrain; /**< a pointer to an active grain */
+#define SYNTH_IS_LIVE(syn, v) (((syn)->live[(v) / 64] >> ((v) % 64)) & 1)
 
 
 /**
  * @struct synthesizer
  * @brief synthesizer class contains all activate grain objects
  * 
- * The synthesizer class contains all active grain and write them to the dsp out stream at each routine
+ * The synthesizer class contains all active grain and write them to the dsp out stream at each routine.
+ * 
+ * The voice state is stored as a structure of arrays: every field lives in its own contiguous array
+ * indexed by the voice number, and a bitmask marks the voices that are playing. Rendering walks the
+ * set bits of the mask and only touches the fields it needs. All arrays are allocated on creation,
+ * so activating and releasing a voice never calls the heap.
+ * 
+ * A voice is either streamed straight from the delay line or, if the write tap would overwrite it
+ * before it has finished, copied into one of a small number of snapshot buffers.
+ * 
+ * Copied voices are filled incrementally. Every block a voice copies at least what its playhead
+ * consumes and what the write tap is about to overwrite. Spare work up to @ref SYNTH_COPY_BUDGET samples
+ * per block is spent on reading further ahead. The cost of a block therefore does not depend on the grain size.
  */
 typedef struct {
-    p_activategrain *data; /**< The stored data itself */
-    int length;            /**< The size of synthesizer */
+    int length;            /**< The maximum number of simultaneously playing voices */
+
+    // hot voice state, read by the render loop
+    double *position;      /**< read position in the delay line (streamed) or in the snapshot (copied) */
+    float *speed;          /**< read speed in the delay line */
+    int *envpos;           /**< evelope phase of streamed voices in samples */
+    int *remaining;        /**< number of samples the voice still has to play */
+    int *offset;           /**< number of samples to wait inside the current block before the voice starts */
+    int *snapshot;         /**< index of the snapshot buffer of copied voices or -1 for streamed voices */
+    evelope *env;          /**< evelope shape of the voices */
+    uint64_t *live;        /**< bitmask of the voices that are playing */
+    int numlive;           /**< number of voices that are playing */
+
+    // copy state, only used by copied voices
+    int *copied;           /**< number of samples already copied into the snapshot */
+    double *copypos;       /**< read position in the delay line of the next sample to be copied */
+    float *deadline;       /**< number of samples until the write tap reaches the first sample of the grain */
+
+    // cold voice state
+    int *repeat;           /**< whether a copied voice should start over instead of being released */
+    grain *origin;         /**< the grain each voice was activated from */
+    circbuf *source;       /**< the delay line the voices are streamed from */
+
+    int *freelist;         /**< stack of voices that are currently unused */
+    int numfree;           /**< number of voices on the free list */
+
+    float *snapshotdata;   /**< sample storage of the snapshot buffers, @ref synthesizer.maxgrainsize samples each */
+    size_t maxgrainsize;   /**< maximum number of samples a snapshot can hold */
+    int *snapshotfree;     /**< stack of snapshot buffers that are currently unused */
+    int numsnapshots;      /**< total number of snapshot buffers */
+    int numsnapshotsfree;  /**< number of snapshot buffers on the free stack */
+
+    float scratch[SYNTH_SCRATCH_SIZE]; /**< scratch space to render streamed voices */
+
+    size_t numacquired;    /**< number of voices taken from the pool so far */
+    size_t numreleased;    /**< number of voices returned to the pool so far */
+    size_t numdropped;     /**< number of grains discarded because the pool was exhausted */
 } synthesizer;
 
 
 /**
- * @memberof activategrain
- * @brief creates a activategrain object
+ * @memberof synthesizer
+ * @brief creates a synthesizer object
  * 
- * This method creates an activategrain object
+ * This method creates a synthesizer object together with all of its voices
  * 
- * @param gn the grain object contains information for activation
- * @param ep the grain object contains evelope
- * @param repeat whether remove this activate grain after reading throught it 
- * @param relativepitch whether to use relative pitch / speed on this grain
+ * @param arena the arena the synthesizer is allocated from
+ * @param length the number of maximun simulteneuly activate grains
+ * @param numsnapshots the number of grains that can be copied out of the delay line at the same time
+ * @param maxgrainsize the maximum size of a copied grain in samples
  * 
- * @return activategrain* a reference to the activategrain object or `NULL` if failed
+ * @return synthesizer* a reference to the synthesizer object or `NULL` if failed
  */
-activategrain *activategrain_new(grain* gn, evelope* ep, int repeat, int relativepitch);
+synthesizer *synthesizer_new(mem_arena *arena, int length, int numsnapshots, size_t maxgrainsize);
 
 /**
- * @memberof activategrain
- * @brief frees an activategrain object
+ * @memberof synthesizer
+ * @brief takes an unused voice in O(1)
  * 
- * This method frees an activategrain object
+ * @param syn the synthesizer object
+ * @return int the voice index or -1 if all voices are in use
+ */
+int synthesizer_acquire_voice(synthesizer *syn);
+
+/**
+ * @memberof synthesizer
+ * @brief stops a voice and returns it and its snapshot buffer in O(1)
  * 
- * @param ag the activategrain object to be freed
+ * @param syn the synthesizer object
+ * @param v the voice index to be released
  */
-void activategrain_free(activategrain *ag);
+void synthesizer_release_voice(synthesizer *syn, int v);
 
+/**
+ * @memberof synthesizer
+ * @brief initializes a voice from a grain and marks it as live
+ * 
+ * A streamed voice only remembers its read position, speed and evelope phase and is rendered
+ * straight from the delay line a block at a time. This is only possible if the write tap
+ * can not overwrite the grain before it has been played. The number of samples the grain can
+ * safely be streamed is stored in the origin's `timeout`.
+ * If streaming is not requested or not safe, a snapshot buffer is reserved instead. It is filled
+ * and multiplied with the evelope incrementally while the voice plays. No memory is allocated in either case.
+ * 
+ * @param syn the synthesizer object
+ * @param v the voice to be initialized
+ * @param gn the grain object contains information for activation
+ * @param ep the grain object contains evelope
+ * @param repeat whether remove this activate grain after reading throught it
+ * @param relativepitch whether to use relative pitch / speed on this grain
+ * @param streaming whether the grain should be streamed from the delay line if possible
+ * @param offset the sample offset inside the current block where the grain starts
+ * @param n the number of samples per dsp block
+ * 
+ * @return int 1 on success, 0 if the grain could neither be streamed nor copied
+ */
+int synthesizer_voice_init(synthesizer *syn, int v, grain* gn, evelope* ep, int repeat, int relativepitch, int streaming, int offset, int n);
 
 /**
  * @memberof synthesizer
- * @brief creates a synthesizer object
+ * @brief fills the snapshot of a copied voice for the next block
  * 
- * This method creates a synthesizer object
+ * The voice copies the samples its playhead reads in this block and the samples the write tap
+ * overwrites in the next block. Further samples are only copied as long as @a budget lasts and
+ * only as far as the write tap has already written them, so a fast grain never copies stale data.
  * 
- * @param length the number of maximun simulteneuly activate grains
+ * @param syn the synthesizer object
+ * @param v the voice
+ * @param n the number of samples per block
+ * @param budget the number of samples that may still be read ahead in this block. It is reduced accordingly
  * 
- * @return synthesizer* a reference to the synthesizer object or `NULL` if failed
+ * @return int the number of samples copied
  */
-synthesizer *synthesizer_new(int length);
+int synthesizer_voice_copy(synthesizer *syn, int v, int n, int *budget);
 
 /**
  * @memberof synthesizer
- * @brief frees a synthesizer object
+ * @brief adds the next block of a voice onto the output
  * 
- * This method frees a synthesizer object
+ * Copied voices mix a contiguous span of their snapshot, streamed voices are read from the delay line
+ * and enveloped first. The voice's remaining length is updated once for the whole block.
  * 
- * @param syn the synthesizer object to be freed
+ * @param syn the synthesizer object
+ * @param v the voice
+ * @param out the output buffer to add the samples to
+ * @param n the number of samples in the block
+ * 
+ * @return int 1 if the voice continues in the next block, 0 if it is finished
  */
-void synthesizer_free(synthesizer *syn);
+int synthesizer_voice_render(synthesizer *syn, int v, float *out, int n);
 
 /**
  * @memberof synthesizer
@@ -109,8 +193,11 @@ void synthesizer_free(synthesizer *syn);
  * @param gn the grain object contains information for activation
  * @param ep the grain object contains evelope
  * @param relativepitch wether to use relative pitch
+ * @param streaming wether to stream the grain from the delay line if possible
+ * @param offset the sample offset inside the current block where the grain starts
+ * @param n the number of samples per dsp block
  */
-void synthesizer_active_grain(synthesizer *syn, grain* gn, evelope* ep, int relativepitch);
+void synthesizer_active_grain(synthesizer *syn, grain* gn, evelope* ep, int relativepitch, int streaming, int offset, int n);
 
 /**
  * @memberof synthesizer
@@ -118,6 +205,7 @@ void synthesizer_active_grain(synthesizer *syn, grain* gn, evelope* ep, int rela
  * 
  * This method changes the repeat parameter of all activated grains to achieve freeze effect.
  * by switched to 1, the synthesizer will not discard grains after being written over rather start from begining.
+ * Streamed grains are not affected, as their source keeps moving.
  * 
  * @param syn the synthesizer object that stores activate grains
  * @param repeat the repeat parameter want to assign to all activate grains
@@ -128,15 +216,11 @@ void synthesizer_freeze_grains(synthesizer *syn, int repeat);
  * @memberof synthesizer
  * @brief write out stream
  * 
- * This method writes activate grains to out stream at each dsp routine
+ * This method writes activate grains to out stream at each dsp routine.
+ * The cost is proportional to the number of active voices times @a n.
  * 
  * @param syn the synthesizer object that stores activate grains
  * @param out the output buffer to be writen
  * @param n number of samples to write
  */
 void synthesizer_write_output(synthesizer *syn, float *out, int n);
-
-
-
-
-
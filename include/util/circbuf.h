@@ -12,6 +12,7 @@
 #pragma once
 
 #include <stddef.h>
+#include "util/mem.h"
 
 
 /**
@@ -26,6 +27,37 @@
  */
 #define CIRCBUF_DIST(a, b, size) ((a) <= (b) ? (b) - (a) : (size) - (a) + (b))
 
+#define CIRCBUF_SINC_TAPS 8 /**< number of taps of the windowed sinc kernel */
+#define CIRCBUF_SINC_PHASES 256 /**< number of fractional positions the sinc kernel is tabulated at */
+#define CIRCBUF_INTERP_LOOKAHEAD (CIRCBUF_SINC_TAPS / 2) /**< number of samples around the read position an interpolation kernel may access */
+
+
+/**
+ * @enum circbuf_interp
+ * @brief interpolation kernels used to read from fractional positions
+ */
+typedef enum {
+    CIRCBUF_INTERP_NONE = 0, /**< zero-order hold, the position is truncated */
+    CIRCBUF_INTERP_LINEAR, /**< linear interpolation between two samples */
+    CIRCBUF_INTERP_HERMITE, /**< 4-point, 3rd-order hermite interpolation */
+    CIRCBUF_INTERP_SINC, /**< 8-point blackman windowed sinc, tabulated at @ref CIRCBUF_SINC_PHASES phases */
+    CIRCBUF_INTERP_COUNT /**< number of interpolation kernels */
+} circbuf_interp;
+
+/**
+ * @enum circbuf_format
+ * @brief sample formats the buffer can store its data in
+ * 
+ * The compact formats halve the memory of the buffer. Samples are converted when they are written
+ * and converted back inside the interpolation kernels.
+ */
+typedef enum {
+    CIRCBUF_FORMAT_FLOAT = 0, /**< 32 bit floating point, stored as is */
+    CIRCBUF_FORMAT_INT16, /**< 16 bit signed integer, samples are clipped to [-1, 1] */
+    CIRCBUF_FORMAT_FLOAT16, /**< 16 bit half precision floating point, subnormals are flushed to zero */
+    CIRCBUF_FORMAT_COUNT /**< number of sample formats */
+} circbuf_format;
+
 
 /**
  * @struct circbuf_writetap
@@ -69,9 +101,13 @@ typedef struct circbuf_readtap circbuf_readtap;
  * read and write taps.
  */
 typedef struct {
-    float *data; /**< The stored data itself */
+    void *data; /**< The stored data itself, @ref circbuf.samplesize bytes per sample */
+    circbuf_format format; /**< The format of the stored samples */
+    size_t samplesize; /**< The number of bytes of a single sample */
     size_t size; /**< The size of the buffer and its data array */
     size_t num_readtaps; /**< The number of read taps */
+    circbuf_interp interp; /**< The kernel used to read from fractional positions */
+    int mirrored; /**< Whether the data is mapped twice back to back, so that `data[size + i]` is `data[i]` */
 
     circbuf_writetap writetap; /**< The write tap assigned to this buffer */
     circbuf_readtap readtaps[]; /**< A list of read taps or `NULL` if there are none */
@@ -82,32 +118,49 @@ typedef struct {
  * @memberof circbuf
  * @brief create a new circular buffer of a specific @a size
  * 
+ * On Linux the data is backed by a memfd that is mapped twice in a row, so that any span of up to
+ * @a size samples is contiguous in memory and neither reads nor writes have to be split at the wrap point.
+ * If that is not possible, or `CIRCBUF_NO_MIRROR` is defined, a plain array is taken from the arena instead.
+ * 
+ * @param arena the arena the buffer is allocated from
  * @param size size of the circular buffer. This must be a power of two
- * @param num_readtaps number of read taps to create
+ * @param num_readtaps number of read taps to create. The interpolation defaults to @ref CIRCBUF_INTERP_NONE
+ * @param format the format the samples are stored in. The buffer is initialized with silence
  * @return circbuf* a reference to the allocated circular buffer or `NULL` if the allocation failed.
  */
-circbuf *circbuf_new(size_t size, size_t num_readtaps);
+circbuf *circbuf_new(mem_arena *arena, size_t size, size_t num_readtaps, circbuf_format format);
 
 /**
  * @memberof circbuf 
- * @brief free and existing circular buffer
+ * @brief release the mirrored mapping of a circular buffer
  * 
- * This function will free all taps. Therefore, all userdata must be freed and set to NULL before
- * calling this function
- * @see circbuf_readtap_free
+ * The buffer itself and its taps belong to the arena and are released with it.
+ * This must be called before the arena is freed.
  * 
  * @param cb the buffer to be freed
  */
 void circbuf_free(circbuf *cb);
 
+/**
+ * @memberof circbuf
+ * @brief prefault and lock the data of a circular buffer
+ * 
+ * Both halves of a mirrored buffer are faulted in, so that neither view causes a page fault later on.
+ * 
+ * @param cb the buffer to be locked
+ * @return int 1 if the data is locked, 0 otherwise
+ * @see mem_lock
+ */
+int circbuf_lock(circbuf *cb);
+
 
 /**
  * @memberof circbuf
  * @brief write a block of data into the buffer and update the write tap position
  * 
- * The function tries to copy all the data at once using `memcpy`.
- * If that is not possible, because the block cuts of at the end of the buffer, both halfs are
- * copied in two seperate steps.
+ * The function tries to copy all the data at once, converting it to the buffer's format on the way.
+ * If that is not possible, because the block cuts of at the end of the buffer and the buffer is not
+ * mirrored, both halfs are copied in two seperate steps.
  * 
  * the buffer's @ref circbuf_writetap.position is updated accordingly
  * 
@@ -121,7 +174,8 @@ void circbuf_write_block(circbuf *cb, float *src, size_t n);
  * @memberof circbuf
  * @brief read a single sample from the buffer at the specified @a tap
  * 
- * Because the readtap's position might be a float, multiple samples might be interpolated
+ * Because the readtap's position might be a float, multiple samples are interpolated with the
+ * buffer's @ref circbuf.interp kernel.
  * After the sample is read, the position is moved forward according to @ref circbuf_readtap.speed
  * 
  * @param cb the buffer to read data from
@@ -144,3 +198,25 @@ float circbuf_read_interp(circbuf *cb, size_t tap);
  * @param n the number of samples to be read
  */
 void circbuf_read_block(circbuf *cb, size_t tap, float *dst, size_t n);
+
+/**
+ * @memberof circbuf
+ * @brief read multiple samples from an arbitrary position without using a read tap
+ * 
+ * This is the kernel behind circbuf_read_block(circbuf *, size_t, float *, size_t). It allows callers
+ * to keep their read positions in their own (contiguous) arrays.
+ * 
+ * The samples are interpolated with the buffer's @ref circbuf.interp kernel. Each kernel has a branch-free
+ * loop over the block that wraps the indices with a mask. If the block is read at the original speed
+ * and does not wrap around, the kernel reduces to a short FIR filter over contiguous memory, or to a
+ * plain copy if the position is an integer.
+ * The position is a double, so that the fraction stays exact far into the delay line.
+ * 
+ * @param cb the buffer to read data from
+ * @param position the position of the first sample
+ * @param speed the distance between two samples
+ * @param dst the destination array to write the samples to
+ * @param n the number of samples to be read
+ * @return double the position after the last sample that was read
+ */
+double circbuf_read_span(circbuf *cb, double position, float speed, float *dst, size_t n);
@@ -29,3 +29,115 @@
     #define malloc(size) sysmem_newptrclear(size)
     #define realloc(size) sysmem_resizeptr(size)
 #endif
+
+
+/**
+ * Debug builds count every heap call made through this header, so that the real time
+ * paths can verify that they do not touch the allocator.
+ * Define MEM_NO_REDEFINE before including this header to get the plain libc functions.
+ */
+#if defined(DEBUG) && !defined(MAXMSPSDK)
+    extern size_t mem_heapcalls; /**< total number of counted heap calls */
+
+    void *mem_counted_malloc(size_t size);
+    void *mem_counted_calloc(size_t num, size_t size);
+    void *mem_counted_realloc(void *ptr, size_t size);
+    void mem_counted_free(void *ptr);
+
+    #ifndef MEM_NO_REDEFINE
+        #define malloc(size) mem_counted_malloc(size)
+        #define calloc(num, size) mem_counted_calloc(num, size)
+        #define realloc(ptr, size) mem_counted_realloc(ptr, size)
+        #define free(ptr) mem_counted_free(ptr)
+    #endif
+#endif
+
+
+#define MEM_CACHELINE 64 /**< alignment of every allocation made from an arena */
+#define MEM_HUGEPAGE 2097152 /**< size of a transparent huge page on most systems */
+
+/**
+ * @struct mem_arena
+ * @brief a single region of memory that all objects of an instance are carved from
+ * 
+ * The region is taken from fresh anonymous pages where the platform has them, otherwise from `calloc`.
+ * Either way the operating system zero-fills the pages when they are first touched, so objects do not
+ * need to clear their buffers and memory that is never used costs nothing.
+ * Allocations can not be freed one by one, the whole arena is released at once.
+ */
+typedef struct {
+    char *base; /**< start of the region as returned by the system. The arena itself is stored at the beginning */
+    size_t size; /**< number of bytes available from the arena's own address on */
+    size_t used; /**< number of bytes handed out so far, including the arena itself */
+    int mapped; /**< whether the region was mapped with `mmap` instead of `calloc` */
+} mem_arena;
+
+/**
+ * @memberof mem_arena
+ * @brief create an arena of @a size bytes
+ * 
+ * @param size the capacity of the arena. Only the pages that are touched are backed by memory
+ * @return mem_arena* the new arena or `NULL` if the region could not be reserved
+ */
+mem_arena *mem_arena_new(size_t size);
+
+/**
+ * @memberof mem_arena
+ * @brief release an arena and every object allocated from it
+ * 
+ * @param arena the arena to be released
+ */
+void mem_arena_free(mem_arena *arena);
+
+/**
+ * @memberof mem_arena
+ * @brief take @a size zeroed bytes from the arena, aligned to @ref MEM_CACHELINE
+ * 
+ * @param arena the arena to allocate from
+ * @param size the number of bytes
+ * @return void* the memory or `NULL` if the arena is exhausted
+ */
+void *mem_arena_alloc(mem_arena *arena, size_t size);
+
+/**
+ * @memberof mem_arena
+ * @brief copy a string into the arena
+ * 
+ * @param arena the arena to allocate from
+ * @param s the string to be copied
+ * @return char* the copy or `NULL` if the arena is exhausted
+ */
+char *mem_arena_strdup(mem_arena *arena, const char *s);
+
+/**
+ * @memberof mem_arena
+ * @brief prefault and lock the part of the arena that has been handed out
+ * 
+ * @param arena the arena
+ * @return int 1 if the memory is locked, 0 otherwise
+ * @see mem_lock
+ */
+int mem_arena_lock(mem_arena *arena);
+
+
+/**
+ * @brief prefault and lock a range of memory, so that using it never causes a page fault
+ * 
+ * Where the system supports it, the range is first advised to be backed by transparent huge pages.
+ * Then every page is faulted in and locked. Locking fails if the limit of locked memory is too low
+ * (see `ulimit -l`), the pages are still faulted in then, but they may be swapped out again.
+ * 
+ * @param ptr the start of the range
+ * @param bytes the size of the range in bytes
+ * @return int 1 if the range is locked, 0 otherwise
+ */
+int mem_lock(void *ptr, size_t bytes);
+
+/**
+ * @brief get the number of bytes the process may lock in memory
+ * 
+ * The limit is shared by everything the process locks.
+ * 
+ * @return size_t the limit of locked memory or `SIZE_MAX` if there is none or it is unknown
+ */
+size_t mem_lock_limit(void);
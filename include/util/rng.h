@@ -0,0 +1,90 @@
+/**
+ * @file rng.h
+ * @brief small, fast pseudo random number generator with a normal sampler
+ * 
+ * Every user keeps its own generator, so the sequences do not depend on other instances or threads
+ * and are reproducible from the seed. The generator is xoshiro128** by Blackman and Vigna, normal variates
+ * are drawn with the ziggurat method by Marsaglia and Tsang.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * @struct rng
+ * @brief state of a xoshiro128** generator
+ */
+typedef struct {
+    uint32_t s[4]; /**< the state, never all zero */
+} rng;
+
+
+/**
+ * @memberof rng
+ * @brief seed a generator
+ * 
+ * The seed is expanded with splitmix64, so that similar seeds give unrelated sequences.
+ * 
+ * @param r the generator
+ * @param seed any value, including 0
+ */
+void rng_seed(rng *r, uint64_t seed);
+
+/**
+ * @memberof rng
+ * @brief the next 32 random bits
+ * 
+ * @param r the generator
+ * @return uint32_t uniformly distributed bits
+ */
+static inline uint32_t rng_next(rng *r) {
+    uint32_t *s = r->s;
+    uint32_t x = s[1] * 5;
+    uint32_t result = ((x << 7) | (x >> 25)) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+
+    return result;
+}
+
+/**
+ * @memberof rng
+ * @brief a uniformly distributed float
+ * 
+ * @param r the generator
+ * @return float a number in the open interval (0, 1)
+ */
+static inline float rng_uniform(rng *r) {
+    return ((rng_next(r) >> 8) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @memberof rng
+ * @brief a standard normal distributed float
+ * 
+ * @param r the generator
+ * @return float a variate with mean 0 and standard deviation 1
+ */
+float rng_normal(rng *r);
+
+/**
+ * @memberof rng
+ * @brief fill a block with standard normal distributed floats
+ * 
+ * About 99% of the variates take the fast path of the ziggurat: one random number, a table lookup
+ * and a multiplication.
+ * 
+ * @param r the generator
+ * @param dst the destination
+ * @param n the number of variates
+ */
+void rng_normal_block(rng *r, float *dst, size_t n);
@@ -41,6 +41,10 @@
     #define __util_clz __builtin_clz
     #define __util_clzl __builtin_clzl
     #define __util_clzll __builtin_clzll
+
+    #define __util_ctz __builtin_ctz
+    #define __util_ctzl __builtin_ctzl
+    #define __util_ctzll __builtin_ctzll
 #elif defined(_MSC_VER)
     #define __util_popcount _mm_popcnt_u32
     #define __util_popcountl _mm_popcnt_u64
@@ -49,6 +53,10 @@
     #define __util_clz __lzcnt
     #define __util_clzl __lzcnt64
     #define __util_clzll __lzcnt64
+
+    #define __util_ctz _tzcnt_u32
+    #define __util_ctzl _tzcnt_u64
+    #define __util_ctzll _tzcnt_u64
 #else
     #error Unsupported compiler
 #endif
@@ -71,6 +79,15 @@
     unsigned long: __util_clzl, \
     unsigned long long: __util_clzll)(x))
 
+/**
+ * @def util_ctz(x)
+ * @brief use the buildin function to compute the number of trailing zeros in @a x. @a x must not be 0
+ */
+#define util_ctz(x) (_Generic((x), \
+    unsigned int: __util_ctz, \
+    unsigned long: __util_ctzl, \
+    unsigned long long: __util_ctzll)(x))
+
 
 /**
  * @def min(a, b)
@@ -0,0 +1,217 @@
+#include "control/mailbox.h"
+
+#include <string.h>
+#include "util/util.h"
+
+
+/**
+ * @brief the bits of a float, so that it can be stored in an atomic integer
+ */
+static uint32_t control_mailbox_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float control_mailbox_float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+
+control_mailbox *control_mailbox_new(mem_arena *arena, int size) {
+    control_mailbox *mb = (control_mailbox *) mem_arena_alloc(arena, sizeof(control_mailbox));
+    if (mb == NULL) return NULL;
+
+    mb->size = size;
+
+    mb->values = mem_arena_alloc(arena, sizeof(_Atomic uint32_t) * max(size, 1));
+    if (mb->values == NULL) return NULL;
+
+    mb->stamps = mem_arena_alloc(arena, sizeof(atomic_uint) * max(size, 1));
+    if (mb->stamps == NULL) return NULL;
+
+    mb->routes = mem_arena_alloc(arena, sizeof(control_route) * CONTROL_MAILBOX_ROUTES);
+    if (mb->routes == NULL) return NULL;
+
+    mb->ids = mem_arena_alloc(arena, sizeof(int) * max(size, 1));
+    if (mb->ids == NULL) return NULL;
+
+    mb->fetched = mem_arena_alloc(arena, sizeof(float) * max(size, 1));
+    if (mb->fetched == NULL) return NULL;
+
+    atomic_init(&mb->sequence, 0);
+    atomic_init(&mb->stamp, 0);
+    atomic_init(&mb->routehead, 0);
+    atomic_init(&mb->routetail, 0);
+    atomic_init(&mb->clears, 0);
+    atomic_init(&mb->clearstamp, 0);
+    atomic_init(&mb->clearhead, 0);
+    atomic_init(&mb->request, CONTROL_MAILBOX_NOREQUEST);
+    atomic_init(&mb->applied, 0);
+    for (int i = 0; i < size; i++) {
+        atomic_init(&mb->values[i], 0);
+        atomic_init(&mb->stamps[i], 0);
+    }
+
+    mb->fetchedstamp = 0;
+    mb->fetchedclears = 0;
+    mb->fetchedtail = 0;
+    mb->fetchedhead = 0;
+    mb->numfetched = 0;
+
+    return mb;
+}
+
+int control_mailbox_post(control_mailbox *mb, const int *ids, const float *values, int count) {
+    unsigned int seq = atomic_load_explicit(&mb->sequence, memory_order_relaxed);
+    unsigned int stamp = atomic_load_explicit(&mb->stamp, memory_order_relaxed) + 1;
+    int i, posted = 0;
+
+    // odd while values are written, the audio thread must not fetch them until the list is complete
+    atomic_store_explicit(&mb->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (i = 0; i < count; i++) {
+        if (ids[i] < 0 || ids[i] >= mb->size) continue;
+
+        atomic_store_explicit(&mb->values[ids[i]], control_mailbox_bits(values[i]), memory_order_relaxed);
+        atomic_store_explicit(&mb->stamps[ids[i]], stamp, memory_order_relaxed);
+        posted++;
+    }
+
+    atomic_store_explicit(&mb->stamp, stamp, memory_order_relaxed);
+    atomic_store_explicit(&mb->sequence, seq + 2, memory_order_release);
+
+    return posted;
+}
+
+int control_mailbox_route(control_mailbox *mb, const control_route *route) {
+    unsigned int head = atomic_load_explicit(&mb->routehead, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&mb->routetail, memory_order_acquire) >= CONTROL_MAILBOX_ROUTES) return 0;
+
+    mb->routes[head % CONTROL_MAILBOX_ROUTES] = *route;
+    atomic_store_explicit(&mb->routehead, head + 1, memory_order_release);
+
+    return 1;
+}
+
+int control_mailbox_peek(control_mailbox *mb, int id, float *value) {
+    unsigned int stamp;
+
+    if (id < 0 || id >= mb->size) return 0;
+
+    // the value was applied already or dropped by a clear
+    stamp = atomic_load_explicit(&mb->stamps[id], memory_order_acquire);
+    if ((int) (stamp - atomic_load_explicit(&mb->applied, memory_order_relaxed)) <= 0) return 0;
+    if ((int) (stamp - atomic_load_explicit(&mb->clearstamp, memory_order_relaxed)) <= 0) return 0;
+
+    *value = control_mailbox_float(atomic_load_explicit(&mb->values[id], memory_order_relaxed));
+    return 1;
+}
+
+unsigned int control_mailbox_clear(control_mailbox *mb, int request) {
+    unsigned int seq = atomic_load_explicit(&mb->sequence, memory_order_relaxed);
+    unsigned int clears = atomic_load_explicit(&mb->clears, memory_order_relaxed) + 1;
+
+    // a clear is published like a list, the audio thread sees all of it or nothing
+    atomic_store_explicit(&mb->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&mb->clearstamp, atomic_load_explicit(&mb->stamp, memory_order_relaxed), memory_order_relaxed);
+    atomic_store_explicit(&mb->clearhead, atomic_load_explicit(&mb->routehead, memory_order_relaxed), memory_order_relaxed);
+    atomic_store_explicit(&mb->request, request, memory_order_relaxed);
+    atomic_store_explicit(&mb->clears, clears, memory_order_relaxed);
+
+    atomic_store_explicit(&mb->sequence, seq + 2, memory_order_release);
+
+    return clears;
+}
+
+int control_mailbox_fetch(control_mailbox *mb) {
+    unsigned int seq, stamp, clears, head, from, tail;
+    int request = CONTROL_MAILBOX_NOREQUEST;
+    int id, n = 0;
+
+    // nothing is applied unless the fetch succeeds
+    tail = atomic_load_explicit(&mb->routetail, memory_order_relaxed);
+    mb->fetchedtail = tail;
+    mb->fetchedhead = tail;
+    mb->numfetched = 0;
+
+    seq = atomic_load_explicit(&mb->sequence, memory_order_acquire);
+    stamp = atomic_load_explicit(&mb->stamp, memory_order_relaxed);
+    clears = atomic_load_explicit(&mb->clears, memory_order_relaxed);
+    head = atomic_load_explicit(&mb->routehead, memory_order_acquire);
+
+    // cheap test first, most blocks have nothing to fetch
+    if (stamp == mb->fetchedstamp && clears == mb->fetchedclears && head == tail) return CONTROL_MAILBOX_NOREQUEST;
+
+    // a list or a clear is being posted, everything waits for the next block
+    if (seq & 1) return CONTROL_MAILBOX_NOREQUEST;
+
+    from = mb->fetchedstamp;
+    if (clears != mb->fetchedclears) {
+        // what was posted before the clear is dropped
+        from = atomic_load_explicit(&mb->clearstamp, memory_order_relaxed);
+        tail = atomic_load_explicit(&mb->clearhead, memory_order_relaxed);
+        request = atomic_load_explicit(&mb->request, memory_order_relaxed);
+    }
+
+    if (stamp != from) {
+        for (id = 0; id < mb->size; id++) {
+            if ((int) (atomic_load_explicit(&mb->stamps[id], memory_order_relaxed) - from) <= 0) continue;
+
+            mb->ids[n] = id;
+            mb->fetched[n++] = control_mailbox_float(atomic_load_explicit(&mb->values[id], memory_order_relaxed));
+        }
+    }
+
+    // a list or a clear was posted in the meantime, the values may be mixed. Everything waits for the next block
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&mb->sequence, memory_order_relaxed) != seq) return CONTROL_MAILBOX_NOREQUEST;
+
+    mb->fetchedstamp = stamp;
+    mb->fetchedclears = clears;
+    mb->fetchedtail = tail;
+    mb->fetchedhead = head;
+    mb->numfetched = n;
+
+    return request;
+}
+
+int control_mailbox_apply(control_mailbox *mb, control_parameter **params) {
+    unsigned int tail = mb->fetchedtail;
+    control_route *r;
+    int i, count = 0;
+
+    // the routing changes in the order they were posted
+    for (; tail != mb->fetchedhead; tail++) {
+        r = &mb->routes[tail % CONTROL_MAILBOX_ROUTES];
+
+        switch (r->type) {
+            case CONTROL_ROUTE_ATTACH: control_parameter_attach(params[r->id], r->slot, r->mod); break;
+            case CONTROL_ROUTE_DETACH: control_parameter_detach(params[r->id], r->slot); break;
+            case CONTROL_ROUTE_AMOUNT: control_parameter_amount(params[r->id], r->slot, r->amount); break;
+        }
+        count++;
+    }
+
+    // the ring also frees the changes that a clear dropped
+    if (mb->fetchedhead != atomic_load_explicit(&mb->routetail, memory_order_relaxed)) {
+        atomic_store_explicit(&mb->routetail, mb->fetchedhead, memory_order_release);
+    }
+
+    for (i = 0; i < mb->numfetched; i++) {
+        control_parameter_set(params[mb->ids[i]], mb->fetched[i]);
+        count++;
+    }
+
+    atomic_store_explicit(&mb->applied, mb->fetchedstamp, memory_order_relaxed);
+    mb->fetchedtail = mb->fetchedhead;
+    mb->numfetched = 0;
+
+    return count;
+}
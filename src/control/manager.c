@@ -3,31 +3,113 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "util/util.h"
 
 
-control_manager *control_manager_new() {
-    control_manager *mgr = (control_manager *) malloc(sizeof(control_manager));
-    if (mgr == NULL) return NULL;
+#define CONTROL_INDEX_MINCAPACITY 64
 
-    mgr->parameters = NULL;
-    mgr->modulators = NULL;
 
-    return mgr;
+/**
+ * @brief 32 bit FNV-1a hash of a name
+ */
+static uint32_t control_index_hash(const char *name) {
+    uint32_t h = 2166136261u;
+
+    for (; *name; name++) h = (h ^ (unsigned char) *name) * 16777619u;
+
+    return h;
 }
 
-void control_manager_free(control_manager *mgr) {
-    control_parameter *p, *ptmp;
-    control_modulator *m, *mtmp;
+static void *control_index_find(const control_index *idx, const char *name) {
+    control_index_entry *e;
+    uint32_t h;
+    size_t i;
 
-    LL_FOREACH_SAFE(mgr->parameters, p, ptmp) {
-        control_parameter_free(p);
+    if (idx->count == 0) return NULL;
+
+    h = control_index_hash(name);
+    for (i = h & (idx->capacity - 1);; i = (i + 1) & (idx->capacity - 1)) {
+        e = &idx->entries[i];
+        if (e->name == NULL) return NULL;
+        if (e->hash == h && strcmp(e->name, name) == 0) return e->item;
     }
+}
 
-    LL_FOREACH_SAFE(mgr->modulators, m, mtmp) {
-        control_modulator_free(m);
+/**
+ * @brief put an item into a slot of a table that has room for it, an existing name is kept
+ */
+static void control_index_put(control_index *idx, const char *name, uint32_t h, void *item) {
+    control_index_entry *e;
+    size_t i;
+
+    for (i = h & (idx->capacity - 1);; i = (i + 1) & (idx->capacity - 1)) {
+        e = &idx->entries[i];
+        if (e->name == NULL) break;
+        if (e->hash == h && strcmp(e->name, name) == 0) return;
     }
 
-    free(mgr);
+    e->name = name;
+    e->hash = h;
+    e->item = item;
+    idx->count++;
+}
+
+/**
+ * @brief add an item to the table, doubling its size if it gets more than half full
+ * 
+ * @return int 1 on success, 0 if the allocation failed
+ */
+static int control_index_insert(mem_arena *arena, control_index *idx, const char *name, void *item) {
+    control_index_entry *old = idx->entries;
+    size_t oldcapacity = idx->capacity, i;
+
+    if (2 * (idx->count + 1) > idx->capacity) {
+        size_t capacity = max(CONTROL_INDEX_MINCAPACITY, 2 * oldcapacity);
+
+        // the old table is returned with the arena
+        idx->entries = mem_arena_alloc(arena, sizeof(control_index_entry) * capacity);
+        if (idx->entries == NULL) {
+            idx->entries = old;
+            return 0;
+        }
+
+        memset(idx->entries, 0, sizeof(control_index_entry) * capacity);
+        idx->capacity = capacity;
+        idx->count = 0;
+
+        for (i = 0; i < oldcapacity; i++) {
+            if (old[i].name) control_index_put(idx, old[i].name, old[i].hash, old[i].item);
+        }
+    }
+
+    control_index_put(idx, name, control_index_hash(name), item);
+
+    return 1;
+}
+
+static void control_index_clear(control_index *idx) {
+    if (idx->entries) memset(idx->entries, 0, sizeof(control_index_entry) * idx->capacity);
+    idx->count = 0;
+}
+
+
+control_manager *control_manager_new(mem_arena *arena) {
+    control_manager *mgr = (control_manager *) mem_arena_alloc(arena, sizeof(control_manager));
+    if (mgr == NULL) return NULL;
+
+    mgr->arena = arena;
+    mgr->parameters = NULL;
+    mgr->modulators = NULL;
+    mgr->numblocks = 0;
+    mgr->paramindex = (control_index) {NULL, 0, 0};
+    mgr->modindex = (control_index) {NULL, 0, 0};
+    mgr->steps = NULL;
+    mgr->numsteps = 0;
+    mgr->stepcapacity = 0;
+    mgr->numactive = 0;
+    mgr->dirty = 1;
+
+    return mgr;
 }
 
 control_parameter *control_manager_parameter_add(control_manager *mgr,
@@ -35,26 +117,57 @@ control_parameter *control_manager_parameter_add(control_manager *mgr,
         float default_value,
         float min,
         float max) {
-    control_parameter *p = control_parameter_new(name, default_value, min, max);
+    control_parameter *p = control_parameter_new(mgr->arena, name, default_value, min, max);
     if (p == NULL) return NULL;
+    if (!control_index_insert(mgr->arena, &mgr->paramindex, p->name, p)) return NULL;
 
+    p->graphdirty = &mgr->dirty;
     LL_APPEND(mgr->parameters, p);
+    mgr->dirty = 1;
+
+    return p;
+}
+
+control_parameter *control_manager_modulator_parameter_add(control_manager *mgr,
+        control_modulator *owner,
+        const char *name,
+        float default_value,
+        float min,
+        float max) {
+    control_parameter *p = control_manager_parameter_add(mgr, name, default_value, min, max);
+    if (p == NULL) return NULL;
+
+    p->owner = owner;
 
     return p;
 }
 
 void control_manager_parameter_remove(control_manager *mgr, control_parameter *p) {
+    control_parameter *q;
+
     LL_DELETE(mgr->parameters, p);
-    control_parameter_free(p);
+    p->graphdirty = NULL;
+    mgr->dirty = 1;
+
+    // rebuild the index in list order, so that a parameter with the same name takes the place of the removed one
+    control_index_clear(&mgr->paramindex);
+    LL_FOREACH(mgr->parameters, q) control_index_insert(mgr->arena, &mgr->paramindex, q->name, q);
 }
 
-control_parameter *control_manager_parameter_by_name(control_manager *mgr, const char *name) {
-    control_parameter *p;
-    LL_FOREACH(mgr->parameters, p) {
-        if (strcmp(p->name, name) == 0) return p;
-    }
+int control_manager_parameter_audiorate(control_manager *mgr, control_parameter *p, size_t maxblock) {
+    if (p->rampcapacity >= maxblock) return 1;
 
-    return NULL;
+    p->ramp = mem_arena_alloc(mgr->arena, sizeof(float) * maxblock);
+    if (p->ramp == NULL) return 0;
+
+    p->rampcapacity = maxblock;
+    p->ramplength = 0;
+
+    return 1;
+}
+
+control_parameter *control_manager_parameter_by_name(control_manager *mgr, const char *name) {
+    return (control_parameter *) control_index_find(&mgr->paramindex, name);
 }
 
 
@@ -62,54 +175,205 @@ control_modulator *control_manager_modulator_add(control_manager *mgr,
         const char *name,
         control_modulator_perform_method perform_method,
         size_t subclass_size) {
-    control_modulator *m = control_modulator_new(name, perform_method, subclass_size);
+    control_modulator *m = control_modulator_new(mgr->arena, name, perform_method, subclass_size);
     if (m == NULL) return NULL;
+    if (!control_index_insert(mgr->arena, &mgr->modindex, m->name, m)) return NULL;
 
     LL_APPEND(mgr->modulators, m);
+    mgr->dirty = 1;
 
     return m;
 }
 
 void control_manager_modulator_remove(control_manager *mgr, control_modulator *m) {
+    control_modulator *q;
+
     LL_DELETE(mgr->modulators, m);
-    control_modulator_free(m);
+    mgr->dirty = 1;
+
+    control_index_clear(&mgr->modindex);
+    LL_FOREACH(mgr->modulators, q) control_index_insert(mgr->arena, &mgr->modindex, q->name, q);
 }
 
 control_modulator *control_manager_modulator_by_name(control_manager *mgr, const char *name) {
-    control_modulator *m;
-    LL_FOREACH(mgr->modulators, m) {
-        if (strcmp(m->name, name) == 0) return m;
+    return (control_modulator *) control_index_find(&mgr->modindex, name);
+}
+
+
+void control_manager_reset(control_manager *mgr) {
+    control_parameter *p;
+    int i;
+
+    LL_FOREACH(mgr->parameters, p) {
+        p->offset = p->reset;
+        p->value = p->reset;
+        for (i = 0; i < CONTROL_NUM_SLOTS; i++) {
+            if (p->slots[i].mod) {
+                control_parameter_amount(p, i, 1.0f);
+                control_parameter_detach(p, i);
+            }
+        }
+    }
+}
+
+
+// marks of the depth first search in control_manager_compile
+#define CONTROL_MARK_NEW 0
+#define CONTROL_MARK_VISITING 1
+#define CONTROL_MARK_DONE 2
+
+static void control_manager_visit_modulator(control_manager *mgr, control_modulator *m);
+
+/**
+ * @brief append the modulators a parameter depends on and then the parameter itself to the steps
+ */
+static void control_manager_visit_parameter(control_manager *mgr, control_parameter *p) {
+    int i;
+
+    // a parameter that is being visited closes a cycle and is read with the value of the previous block
+    if (p->mark != CONTROL_MARK_NEW) return;
+    p->mark = CONTROL_MARK_VISITING;
+
+    for (i = 0; i < CONTROL_NUM_SLOTS; i++) {
+        if (p->slots[i].mod) control_manager_visit_modulator(mgr, p->slots[i].mod);
     }
 
-    return NULL;
+    p->mark = CONTROL_MARK_DONE;
+    mgr->steps[mgr->numsteps].mod = NULL;
+    mgr->steps[mgr->numsteps++].param = p;
 }
 
+/**
+ * @brief append the parameters of a modulator and then the modulator itself to the steps
+ */
+static void control_manager_visit_modulator(control_manager *mgr, control_modulator *m) {
+    control_parameter *p;
+
+    if (m->mark != CONTROL_MARK_NEW) return;
+    m->mark = CONTROL_MARK_VISITING;
 
-void control_manager_perform(control_manager *mgr, float *in, int n) {
+    LL_FOREACH(mgr->parameters, p) {
+        if (p->owner == m) control_manager_visit_parameter(mgr, p);
+    }
+
+    m->mark = CONTROL_MARK_DONE;
+    mgr->steps[mgr->numsteps].mod = m;
+    mgr->steps[mgr->numsteps++].param = NULL;
+    mgr->numactive++;
+}
+
+int control_manager_compile(control_manager *mgr) {
     control_modulator *m;
     control_parameter *p;
-    int i;
-    float v;
+    int count = 0;
+
+    LL_FOREACH(mgr->parameters, p) {
+        p->mark = CONTROL_MARK_NEW;
+        count++;
+    }
+    LL_FOREACH(mgr->modulators, m) {
+        m->mark = CONTROL_MARK_NEW;
+        count++;
+    }
+
+    // the graph only grows while the instance is set up, the old array is returned with the arena
+    if (count > mgr->stepcapacity) {
+        control_step *steps = mem_arena_alloc(mgr->arena, sizeof(control_step) * count);
+        if (steps == NULL) {
+            fprintf(stderr, "control_manager_compile: out of memory\n");
+            return 0;
+        }
+
+        mgr->steps = steps;
+        mgr->stepcapacity = count;
+    }
 
-    // update all modulators
+    mgr->numsteps = 0;
+    mgr->numactive = 0;
+
+    // modulators that write parameters themselves go first, so that their changes are read in the same block
     LL_FOREACH(mgr->modulators, m) {
-        m->perform_method(m, in, n);
+        if (m->root) control_manager_visit_modulator(mgr, m);
     }
 
-    // update all parameters
+    // everything the engine reads, in dependency order
     LL_FOREACH(mgr->parameters, p) {
-        v = p->offset;
+        if (p->owner == NULL) control_manager_visit_parameter(mgr, p);
+    }
 
-        // apply each modulator slot weighted by its amount
-        for (i = 0; i < CONTROL_NUM_SLOTS; i++) {
-            if (p->slots[i].mod != NULL) {
-                v += p->slots[i].amount * p->slots[i].mod->value;
-            }
+    // parameters of modulators without a consumer, they only depend on values that are already computed
+    LL_FOREACH(mgr->parameters, p) {
+        if (p->mark == CONTROL_MARK_NEW) {
+            p->mark = CONTROL_MARK_DONE;
+            mgr->steps[mgr->numsteps].mod = NULL;
+            mgr->steps[mgr->numsteps++].param = p;
         }
+    }
+
+    mgr->dirty = 0;
+
+    return 1;
+}
+
+
+/**
+ * @brief fill a ramp that ends at @a to after @a n samples
+ */
+static void control_manager_ramp(float *restrict dst, float from, float to, int n) {
+    float step = (to - from) / n;
+
+    for (int i = 0; i < n; i++) dst[i] = from + step * (i + 1);
+    dst[n - 1] = to;
+}
+
+/**
+ * @brief compute the value of a parameter from its offset and modulators
+ */
+static inline void control_manager_update(control_manager *mgr, control_parameter *p, int n) {
+    int i;
+    float v, from;
 
-        if (v < p->min) v = p->min;
-        if (v > p->max) v = p->max;
+    v = p->offset;
 
-        p->value = v;
+    // apply each modulator slot weighted by its amount
+    for (i = 0; i < CONTROL_NUM_SLOTS; i++) {
+        if (p->slots[i].mod != NULL) {
+            v += p->slots[i].amount * p->slots[i].mod->value;
+        }
     }
+
+    if (v < p->min) v = p->min;
+    if (v > p->max) v = p->max;
+
+    // a parameter that did not change is read from its value, only changes are ramped
+    if (p->ramp) {
+        from = mgr->numblocks ? p->value : v;
+        p->ramplength = from != v && (size_t) n <= p->rampcapacity ? (size_t) n : 0;
+        if (p->ramplength) control_manager_ramp(p->ramp, from, v, n);
+    }
+
+    p->value = v;
+}
+
+void control_manager_perform(control_manager *mgr, float *in, int n) {
+    control_modulator *m;
+    control_parameter *p;
+    control_step *s, *end;
+
+    if (mgr->dirty && !control_manager_compile(mgr)) {
+        // without a compiled graph every modulator is performed, followed by every parameter
+        LL_FOREACH(mgr->modulators, m) {
+            m->perform_method(m, in, n);
+        }
+        LL_FOREACH(mgr->parameters, p) {
+            control_manager_update(mgr, p, n);
+        }
+    } else {
+        for (s = mgr->steps, end = mgr->steps + mgr->numsteps; s < end; s++) {
+            if (s->mod) s->mod->perform_method(s->mod, in, n);
+            else control_manager_update(mgr, s->param, n);
+        }
+    }
+
+    mgr->numblocks++;
 }
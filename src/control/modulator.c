@@ -3,21 +3,21 @@
 #include <string.h>
 
 
-control_modulator *control_modulator_new(const char *name,
+control_modulator *control_modulator_new(mem_arena *arena,
+        const char *name,
         control_modulator_perform_method perform_method,
         size_t subclass_size) {
-    control_modulator *m = (control_modulator *) malloc(subclass_size);
+    control_modulator *m = (control_modulator *) mem_arena_alloc(arena, subclass_size);
     if (m == NULL) return NULL;
 
-    m->name = strdup(name);
+    m->name = mem_arena_strdup(arena, name);
+    if (m->name == NULL) return NULL;
+
     m->perform_method = perform_method;
     m->value = 0.0f;
+    m->mark = 0;
+    m->root = 0;
     m->next = NULL;
 
     return m;
 }
-
-void control_modulator_free(control_modulator *m) {
-    free(m->name);
-    free(m);
-}
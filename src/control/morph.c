@@ -0,0 +1,126 @@
+#include "control/morph.h"
+
+#include <stdio.h>
+
+
+control_morph *control_morph_new(control_manager *mgr, const char *name) {
+    control_morph *mo = (control_morph *) control_manager_modulator_add(mgr,
+        name,
+        (control_modulator_perform_method) control_morph_perform,
+        sizeof(control_morph));
+    control_modulator *m;
+    char namebuf[32];
+    int i = 0;
+    if (mo == NULL) return NULL;
+
+    mo->super.root = 1;
+    mo->mgr = mgr;
+    mo->active = 0;
+    mo->lastposition = -1.0f;
+
+    snprintf(namebuf, sizeof(namebuf), "%s.position", name);
+    mo->position = control_manager_modulator_parameter_add(mgr, &mo->super,
+        namebuf, 0.0f, 0.0f, 1.0f);
+    if (mo->position == NULL) return NULL;
+
+    // the snapshots need to know every parameter, including the position
+    mo->from = control_snapshot_new(mgr->arena, mgr);
+    mo->to = control_snapshot_new(mgr->arena, mgr);
+    if (mo->from == NULL || mo->to == NULL) return NULL;
+
+    mo->mods = mem_arena_alloc(mgr->arena, sizeof(control_modulator *) * (mo->from->nummods + 1));
+    if (mo->mods == NULL) return NULL;
+
+    LL_FOREACH(mgr->modulators, m) mo->mods[i++] = m;
+
+    return mo;
+}
+
+int control_morph_load(control_morph *mo, const control_snapshot *from, const control_snapshot *to) {
+    if (!from->valid || !to->valid) return 0;
+
+    control_snapshot_copy(mo->from, from);
+    control_snapshot_copy(mo->to, to);
+
+    mo->active = 1;
+    mo->lastposition = -1.0f;
+
+    return 1;
+}
+
+void control_morph_stop(control_morph *mo) {
+    mo->active = 0;
+}
+
+/**
+ * @brief linear interpolation that hits both ends exactly
+ */
+static float control_morph_lerp(float a, float b, float t) {
+    return a * (1.0f - t) + b * t;
+}
+
+/**
+ * @brief the modulator of a slot of a snapshot or NULL
+ */
+static control_modulator *control_morph_mod(control_morph *mo, int index) {
+    return index >= 0 && index < mo->from->nummods ? mo->mods[index] : NULL;
+}
+
+void control_morph_perform(control_morph *mo, __attribute__((unused)) float *in, __attribute__((unused)) int n) {
+    control_snapshot_entry *a, *b;
+    control_modulator *ma, *mb, *target;
+    control_parameter *p;
+    float t = control_parameter_get_float(mo->position);
+    float amount;
+    int i = 0, s;
+
+    mo->super.value = t;
+
+    // nothing moved, leave the parameters to the user
+    if (!mo->active || t == mo->lastposition) return;
+    mo->lastposition = t;
+
+    LL_FOREACH(mo->mgr->parameters, p) {
+        if (i == mo->from->numparams) break;
+        a = &mo->from->entries[i];
+        b = &mo->to->entries[i++];
+
+        // the position must not be morphed by itself
+        if (p == mo->position) continue;
+
+        if (p->discrete) control_parameter_set(p, t < 0.5f ? a->offset : b->offset);
+        else control_parameter_set(p, control_morph_lerp(a->offset, b->offset, t));
+
+        for (s = 0; s < CONTROL_NUM_SLOTS; s++) {
+            ma = control_morph_mod(mo, a->mods[s]);
+            mb = control_morph_mod(mo, b->mods[s]);
+
+            if (ma == mb) {
+                target = ma;
+                amount = control_morph_lerp(a->amounts[s], b->amounts[s], t);
+            } else if (mb == NULL) {
+                // detached at the end, so that it leaves the modulation graph
+                target = t < 1.0f ? ma : NULL;
+                amount = a->amounts[s] * (1.0f - t);
+            } else if (ma == NULL) {
+                target = t > 0.0f ? mb : NULL;
+                amount = b->amounts[s] * t;
+            } else if (t < 0.5f) {
+                // two different modulators share the slot: the first one fades out until the midpoint, then the other one fades in
+                target = ma;
+                amount = a->amounts[s] * (1.0f - 2.0f * t);
+            } else {
+                target = mb;
+                amount = b->amounts[s] * (2.0f * t - 1.0f);
+            }
+
+            // the amount of an empty slot is kept for the next modulator attached by hand
+            if (target) control_parameter_amount(p, s, amount);
+
+            // a new routing takes effect in the next block, when the amount is still close to 0
+            if (p->slots[s].mod == target) continue;
+            if (target) control_parameter_attach(p, s, target);
+            else control_parameter_detach(p, s);
+        }
+    }
+}
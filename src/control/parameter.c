@@ -6,16 +6,26 @@
 #include "util/util.h"
 
 
-control_parameter *control_parameter_new(const char *name, float default_value, float min, float max) {
-    control_parameter *p = malloc(sizeof(control_parameter));
+control_parameter *control_parameter_new(mem_arena *arena, const char *name, float default_value, float min, float max) {
+    control_parameter *p = mem_arena_alloc(arena, sizeof(control_parameter));
     if (p == NULL) return NULL;
     
-    p->name = strdup(name);
+    p->name = mem_arena_strdup(arena, name);
+    if (p->name == NULL) return NULL;
+
     p->offset = default_value;
     p->value = default_value;
     p->reset = default_value;
+    p->discrete = 0;
     p->min = min;
     p->max = max;
+    p->ramp = NULL;
+    p->rampcapacity = 0;
+    p->ramplength = 0;
+    p->id = -1;
+    p->owner = NULL;
+    p->graphdirty = NULL;
+    p->mark = 0;
     p->next = NULL;
 
     for (int i = 0; i < CONTROL_NUM_SLOTS; i++) {
@@ -26,11 +36,6 @@ control_parameter *control_parameter_new(const char *name, float default_value,
     return p;
 }
 
-void control_parameter_free(control_parameter *p) {
-    free(p->name);
-    free(p);
-}
-
 
 static int control_parameter_validate_slot(size_t slot) {
     int valid = slot < CONTROL_NUM_SLOTS;
@@ -44,6 +49,7 @@ void control_parameter_attach(control_parameter *p,
     if (!control_parameter_validate_slot(slot)) return;
 
     p->slots[slot].mod = mod;
+    if (p->graphdirty) *p->graphdirty = 1;
 }
 
 void control_parameter_detach(control_parameter *p,
@@ -51,6 +57,7 @@ void control_parameter_detach(control_parameter *p,
     if (!control_parameter_validate_slot(slot)) return;
 
     p->slots[slot].mod = NULL;
+    if (p->graphdirty) *p->graphdirty = 1;
 }
 
 void control_parameter_amount(control_parameter *p,
@@ -61,6 +68,10 @@ void control_parameter_amount(control_parameter *p,
     p->slots[slot].amount = amount;
 }
 
+void control_parameter_discrete(control_parameter *p, int discrete) {
+    p->discrete = discrete;
+}
+
 void control_parameter_set(control_parameter *p, float value) {
     p->offset = value;
 }
@@ -73,3 +84,11 @@ float control_parameter_get_float(control_parameter *p) {
 int control_parameter_get_int(control_parameter *p) {
     return roundf(p->value);
 }
+
+float control_parameter_get_float_at(control_parameter *p, int i) {
+    return i >= 0 && (size_t) i < p->ramplength ? p->ramp[i] : p->value;
+}
+
+int control_parameter_get_int_at(control_parameter *p, int i) {
+    return roundf(control_parameter_get_float_at(p, i));
+}
@@ -0,0 +1,147 @@
+#include "control/preset.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+static int control_preset_slot(const char *source, const char *arg) {
+    char *end;
+    long slot = strtol(arg, &end, 10);
+
+    if (*end != '\0' || slot < 0 || slot >= CONTROL_NUM_SLOTS) {
+        fprintf(stderr, "control_preset_apply: %s: invalid slot %s\n", source, arg);
+        return -1;
+    }
+
+    return (int) slot;
+}
+
+static int control_preset_float(const char *source, const char *arg, float *value) {
+    char *end;
+    *value = strtof(arg, &end);
+
+    if (*end != '\0') {
+        fprintf(stderr, "control_preset_apply: %s: invalid number %s\n", source, arg);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief apply a single message
+ * 
+ * @return int 1 if the message was applied, 0 if it is invalid
+ */
+static int control_preset_message(control_manager *mgr, const char *source, int argc, char **argv) {
+    control_parameter *p = NULL;
+    control_modulator *m;
+    int slot;
+    float value;
+
+    // comments and the name of the preset are not applied
+    if (argv[0][0] == '#' || strcmp(argv[0], "name") == 0) return 1;
+
+    if (strcmp(argv[0], "param-reset") == 0) {
+        control_manager_reset(mgr);
+        return 1;
+    }
+
+    if (argc >= 2 && (p = control_manager_parameter_by_name(mgr, argv[1])) == NULL) {
+        fprintf(stderr, "control_preset_apply: %s: unknown parameter %s\n", source, argv[1]);
+        return 0;
+    }
+
+    if (strcmp(argv[0], "param-set") == 0 && argc == 3) {
+        if (!control_preset_float(source, argv[2], &value)) return 0;
+        control_parameter_set(p, value);
+        return 1;
+    }
+
+    if (strcmp(argv[0], "param-amount") == 0 && argc == 4) {
+        if ((slot = control_preset_slot(source, argv[2])) == -1) return 0;
+        if (!control_preset_float(source, argv[3], &value)) return 0;
+        control_parameter_amount(p, slot, value);
+        return 1;
+    }
+
+    if (strcmp(argv[0], "param-attach") == 0 && argc == 4) {
+        if ((slot = control_preset_slot(source, argv[2])) == -1) return 0;
+        if ((m = control_manager_modulator_by_name(mgr, argv[3])) == NULL) {
+            fprintf(stderr, "control_preset_apply: %s: unknown modulator %s\n", source, argv[3]);
+            return 0;
+        }
+        control_parameter_attach(p, slot, m);
+        return 1;
+    }
+
+    if (strcmp(argv[0], "param-detach") == 0 && argc == 3) {
+        if ((slot = control_preset_slot(source, argv[2])) == -1) return 0;
+        control_parameter_detach(p, slot);
+        return 1;
+    }
+
+    fprintf(stderr, "control_preset_apply: %s: invalid message %s with %d arguments\n", source, argv[0], argc - 1);
+    return 0;
+}
+
+int control_preset_apply(control_manager *mgr, const char *text, const char *source) {
+    char *copy, *msg, *atom, *msgsave, *atomsave;
+    char *argv[CONTROL_PRESET_MAXARGS];
+    int argc, errors = 0;
+
+    // the text is split in place, so work on a copy
+    copy = strdup(text);
+    if (!copy) {
+        fprintf(stderr, "control_preset_apply: %s: out of memory\n", source);
+        return 1;
+    }
+
+    for (msg = strtok_r(copy, ";", &msgsave); msg; msg = strtok_r(NULL, ";", &msgsave)) {
+        argc = 0;
+        for (atom = strtok_r(msg, " \t\r\n", &atomsave); atom; atom = strtok_r(NULL, " \t\r\n", &atomsave)) {
+            if (argc == CONTROL_PRESET_MAXARGS) break;
+            argv[argc++] = atom;
+        }
+
+        if (argc == 0) continue;
+        errors += !control_preset_message(mgr, source, argc, argv);
+    }
+
+    free(copy);
+    return errors;
+}
+
+int control_preset_load(control_manager *mgr, const char *path) {
+    FILE *f;
+    char *text;
+    long size;
+    int errors;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "control_preset_load: could not open %s\n", path);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    text = malloc(size + 1);
+    if (!text || size < 0 || fread(text, 1, size, f) != (size_t) size) {
+        fprintf(stderr, "control_preset_load: could not read %s\n", path);
+        free(text);
+        fclose(f);
+        return -1;
+    }
+
+    text[size] = '\0';
+    fclose(f);
+
+    errors = control_preset_apply(mgr, text, path);
+
+    free(text);
+    return errors;
+}
@@ -0,0 +1,371 @@
+#include "control/snapshot.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "util/util.h"
+
+
+/**
+ * @brief the position of a modulator in the list of the manager or -1
+ */
+static int control_snapshot_mod_index(control_manager *mgr, control_modulator *m) {
+    control_modulator *q;
+    int i = 0;
+
+    if (m == NULL) return -1;
+
+    LL_FOREACH(mgr->modulators, q) {
+        if (q == m) return i;
+        i++;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief the position of a parameter in the list of the manager or -1
+ */
+static int control_snapshot_param_index(control_manager *mgr, control_parameter *p) {
+    control_parameter *q;
+    int i = 0;
+
+    LL_FOREACH(mgr->parameters, q) {
+        if (q == p) return i;
+        i++;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief the state of all parameters after a reset
+ */
+static void control_snapshot_defaults(control_snapshot *snap, control_snapshot_entry *entries, control_manager *mgr) {
+    control_parameter *p;
+    int i = 0, s;
+
+    LL_FOREACH(mgr->parameters, p) {
+        if (i == snap->numparams) break;
+        entries[i].offset = p->reset;
+        for (s = 0; s < CONTROL_NUM_SLOTS; s++) {
+            entries[i].amounts[s] = 1.0f;
+            entries[i].mods[s] = -1;
+        }
+        i++;
+    }
+}
+
+
+control_snapshot *control_snapshot_new(mem_arena *arena, control_manager *mgr) {
+    control_snapshot *snap = (control_snapshot *) mem_arena_alloc(arena, sizeof(control_snapshot));
+    control_parameter *p;
+    control_modulator *m;
+    if (snap == NULL) return NULL;
+
+    LL_COUNT(mgr->parameters, p, snap->numparams);
+    LL_COUNT(mgr->modulators, m, snap->nummods);
+
+    snap->entries = mem_arena_alloc(arena, sizeof(control_snapshot_entry) * (snap->numparams + 1));
+    if (snap->entries == NULL) return NULL;
+
+    control_snapshot_defaults(snap, snap->entries, mgr);
+    snap->valid = 0;
+
+    return snap;
+}
+
+void control_snapshot_capture(control_snapshot *snap, control_manager *mgr) {
+    control_parameter *p;
+    int i = 0, s;
+
+    LL_FOREACH(mgr->parameters, p) {
+        if (i == snap->numparams) break;
+
+        snap->entries[i].offset = p->offset;
+        for (s = 0; s < CONTROL_NUM_SLOTS; s++) {
+            snap->entries[i].amounts[s] = p->slots[s].amount;
+            snap->entries[i].mods[s] = control_snapshot_mod_index(mgr, p->slots[s].mod);
+        }
+        i++;
+    }
+
+    snap->valid = 1;
+}
+
+void control_snapshot_copy(control_snapshot *dst, const control_snapshot *src) {
+    memcpy(dst->entries, src->entries, sizeof(control_snapshot_entry) * min(dst->numparams, src->numparams));
+    dst->valid = src->valid;
+}
+
+void control_snapshot_apply(control_snapshot *snap, control_manager *mgr) {
+    control_modulator *mods[snap->nummods + 1], *m, *target;
+    control_parameter *p;
+    control_snapshot_entry *e;
+    int i = 0, s;
+
+    if (!snap->valid) return;
+
+    LL_FOREACH(mgr->modulators, m) {
+        if (i == snap->nummods) break;
+        mods[i++] = m;
+    }
+
+    i = 0;
+    LL_FOREACH(mgr->parameters, p) {
+        if (i == snap->numparams) break;
+        e = &snap->entries[i++];
+
+        control_parameter_set(p, e->offset);
+        for (s = 0; s < CONTROL_NUM_SLOTS; s++) {
+            control_parameter_amount(p, s, e->amounts[s]);
+
+            // only changes of the routing mark the modulation graph for recompilation
+            target = e->mods[s] >= 0 && e->mods[s] < snap->nummods ? mods[e->mods[s]] : NULL;
+            if (p->slots[s].mod == target) continue;
+
+            if (target) control_parameter_attach(p, s, target);
+            else control_parameter_detach(p, s);
+        }
+    }
+}
+
+
+static void control_snapshot_put_u16(FILE *f, uint16_t v) {
+    unsigned char b[2] = {v & 0xff, v >> 8};
+    fwrite(b, 1, sizeof(b), f);
+}
+
+static void control_snapshot_put_u32(FILE *f, uint32_t v) {
+    unsigned char b[4] = {v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24};
+    fwrite(b, 1, sizeof(b), f);
+}
+
+static void control_snapshot_put_f32(FILE *f, float v) {
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    control_snapshot_put_u32(f, u);
+}
+
+static void control_snapshot_put_name(FILE *f, const char *name) {
+    size_t len = name ? strlen(name) : 0;
+    control_snapshot_put_u16(f, (uint16_t) len);
+    if (len) fwrite(name, 1, len, f);
+}
+
+int control_snapshot_save(control_snapshot *snap, control_manager *mgr, const char *path) {
+    control_parameter *p;
+    control_modulator *mods[snap->nummods + 1], *m;
+    control_snapshot_entry *e;
+    FILE *f;
+    int i = 0, s, ok;
+
+    if (!snap->valid) {
+        fprintf(stderr, "control_snapshot_save: the snapshot is empty\n");
+        return 0;
+    }
+
+    LL_FOREACH(mgr->modulators, m) {
+        if (i == snap->nummods) break;
+        mods[i++] = m;
+    }
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "control_snapshot_save: could not open %s\n", path);
+        return 0;
+    }
+
+    fwrite(CONTROL_SNAPSHOT_MAGIC, 1, strlen(CONTROL_SNAPSHOT_MAGIC), f);
+    control_snapshot_put_u32(f, CONTROL_SNAPSHOT_VERSION);
+    control_snapshot_put_u32(f, snap->numparams);
+    control_snapshot_put_u32(f, CONTROL_NUM_SLOTS);
+
+    i = 0;
+    LL_FOREACH(mgr->parameters, p) {
+        if (i == snap->numparams) break;
+        e = &snap->entries[i++];
+
+        control_snapshot_put_name(f, p->name);
+        control_snapshot_put_f32(f, e->offset);
+        for (s = 0; s < CONTROL_NUM_SLOTS; s++) {
+            control_snapshot_put_name(f, e->mods[s] >= 0 && e->mods[s] < snap->nummods ? mods[e->mods[s]]->name : NULL);
+            control_snapshot_put_f32(f, e->amounts[s]);
+        }
+    }
+
+    ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    if (!ok) fprintf(stderr, "control_snapshot_save: could not write %s\n", path);
+
+    return ok;
+}
+
+
+/**
+ * @brief cursor over the bytes of a snapshot file. Reading past the end sets @ref control_snapshot_reader.error
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t pos;
+    int error;
+} control_snapshot_reader;
+
+static const unsigned char *control_snapshot_take(control_snapshot_reader *r, size_t n) {
+    const unsigned char *b = &r->data[r->pos];
+
+    if (r->error || r->size - r->pos < n) {
+        r->error = 1;
+        return NULL;
+    }
+
+    r->pos += n;
+    return b;
+}
+
+static uint32_t control_snapshot_get_u32(control_snapshot_reader *r) {
+    const unsigned char *b = control_snapshot_take(r, 4);
+    return b ? b[0] | b[1] << 8 | b[2] << 16 | (uint32_t) b[3] << 24 : 0;
+}
+
+static float control_snapshot_get_f32(control_snapshot_reader *r) {
+    uint32_t u = control_snapshot_get_u32(r);
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+/**
+ * @brief read a name into @a buf, names that do not fit are truncated
+ */
+static void control_snapshot_get_name(control_snapshot_reader *r, char *buf, size_t bufsize) {
+    const unsigned char *b = control_snapshot_take(r, 2);
+    size_t len = b ? (size_t) (b[0] | b[1] << 8) : 0;
+
+    buf[0] = '\0';
+    if ((b = control_snapshot_take(r, len)) == NULL) return;
+
+    if (len >= bufsize) len = bufsize - 1;
+    memcpy(buf, b, len);
+    buf[len] = '\0';
+}
+
+/**
+ * @brief parse the contents of a snapshot file into @a entries
+ * 
+ * @return int the number of unknown names or -1 if the file is invalid
+ */
+static int control_snapshot_parse(control_snapshot *snap, control_manager *mgr, control_snapshot_entry *entries,
+        control_snapshot_reader *r, const char *path) {
+    control_parameter *p;
+    control_modulator *m;
+    char name[256];
+    uint32_t version, numparams, numslots, i, s;
+    float offset, amount;
+    int index, unknown = 0;
+
+    if (r->size < strlen(CONTROL_SNAPSHOT_MAGIC) || memcmp(r->data, CONTROL_SNAPSHOT_MAGIC, strlen(CONTROL_SNAPSHOT_MAGIC)) != 0) {
+        fprintf(stderr, "control_snapshot_load: %s is not a snapshot\n", path);
+        return -1;
+    }
+    r->pos = strlen(CONTROL_SNAPSHOT_MAGIC);
+
+    version = control_snapshot_get_u32(r);
+    numparams = control_snapshot_get_u32(r);
+    numslots = control_snapshot_get_u32(r);
+    if (version != CONTROL_SNAPSHOT_VERSION) {
+        fprintf(stderr, "control_snapshot_load: %s has the unsupported version %u\n", path, (unsigned int) version);
+        return -1;
+    }
+
+    for (i = 0; i < numparams && !r->error; i++) {
+        control_snapshot_get_name(r, name, sizeof(name));
+        offset = control_snapshot_get_f32(r);
+
+        p = control_manager_parameter_by_name(mgr, name);
+        index = p ? control_snapshot_param_index(mgr, p) : -1;
+        if (index < 0 || index >= snap->numparams) {
+            if (!r->error) fprintf(stderr, "control_snapshot_load: %s: unknown parameter %s\n", path, name);
+            unknown++;
+            index = -1;
+        } else {
+            entries[index].offset = offset;
+        }
+
+        for (s = 0; s < numslots && !r->error; s++) {
+            control_snapshot_get_name(r, name, sizeof(name));
+            amount = control_snapshot_get_f32(r);
+            if (index < 0 || s >= CONTROL_NUM_SLOTS) continue;
+
+            entries[index].amounts[s] = amount;
+            if (name[0] == '\0') continue;
+
+            if ((m = control_manager_modulator_by_name(mgr, name)) == NULL) {
+                fprintf(stderr, "control_snapshot_load: %s: unknown modulator %s\n", path, name);
+                unknown++;
+                continue;
+            }
+            entries[index].mods[s] = control_snapshot_mod_index(mgr, m);
+        }
+    }
+
+    if (r->error) {
+        fprintf(stderr, "control_snapshot_load: %s is truncated\n", path);
+        return -1;
+    }
+
+    return unknown;
+}
+
+int control_snapshot_load(control_snapshot *snap, control_manager *mgr, const char *path) {
+    control_snapshot_reader r = {0};
+    control_snapshot_entry *entries;
+    unsigned char *data;
+    FILE *f;
+    long size;
+    int unknown;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "control_snapshot_load: could not open %s\n", path);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = malloc(size > 0 ? size : 1);
+    if (!data || size < 0 || fread(data, 1, size, f) != (size_t) size) {
+        fprintf(stderr, "control_snapshot_load: could not read %s\n", path);
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    // the file is parsed into a copy, so that the snapshot stays intact if it is invalid
+    entries = malloc(sizeof(control_snapshot_entry) * (snap->numparams + 1));
+    if (!entries) {
+        fprintf(stderr, "control_snapshot_load: out of memory\n");
+        free(data);
+        return -1;
+    }
+
+    control_snapshot_defaults(snap, entries, mgr);
+
+    r.data = data;
+    r.size = (size_t) size;
+    unknown = control_snapshot_parse(snap, mgr, entries, &r, path);
+
+    if (unknown >= 0) {
+        memcpy(snap->entries, entries, sizeof(control_snapshot_entry) * snap->numparams);
+        snap->valid = 1;
+    }
+
+    free(entries);
+    free(data);
+    return unknown;
+}
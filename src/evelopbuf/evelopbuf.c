@@ -6,248 +6,121 @@
 #include "evelopbuf/evelopbuf.h"
 
 
-evelope *evelope_new(evelope* ep, int type, int length, float amplitude, int attacksamples, int releasesamples){
+evelope *evelope_init(evelope *ep, evelopbuf *eb, int type, int length, float amplitude, int attacksamples, int releasesamples){
+   if (type < 0 || type >= EVELOPE_NUMTYPES){
+      fprintf(stderr, "evelope_init: unsupported evelope type: %d, please check again!!!\n", type);
+      return NULL;
+   }
+
    switch (type){
       case 0:
-         ep = evelope_gen_no_evelope(ep, type, length, amplitude); // only for debugging
+         // only for debugging
+         attacksamples = 0;
+         releasesamples = 0;
          break;
       case 1:
-         ep = evelope_gen_parabolic(ep, type, length, amplitude); 
-         break;
-      case 2:
-         ep = evelope_gen_trapezoidal(ep, type, length, amplitude, attacksamples, releasesamples); 
-         break;         
-      case 3:
-         ep = evelope_gen_raised_cosine_bell(ep, type, length, amplitude, attacksamples, releasesamples); 
+         // the parabola is a single segment over the whole length
+         attacksamples = length;
+         releasesamples = 0;
          break;
       default:
-         error("evelope_new: unsupported evelope type: %d, please check again!!!", type);
-   }
-
-   return ep;
-}
-
-
-void evelope_free(evelope* ep){
-   free(ep->data);
-   free(ep);
-   // post("evelope free!");
-}
-
-
-evelope *evelope_gen_trapezoidal(evelope* ep, int type, int length, float amplitude, int attacksamples, int releasesamples){
-   if (attacksamples + releasesamples > length) {
-      attacksamples = length / 2;
-      releasesamples = length / 2;
+         // make sure attack and release fit into the length
+         if (attacksamples + releasesamples > length) {
+            attacksamples = length / 2;
+            releasesamples = length / 2;
+         }
    }
-   
-   ep = malloc(sizeof(evelope));
-   if (!ep) return NULL;
-
-   ep->data = malloc(sizeof(float) * length);
-   if (!ep->data) return NULL;
 
+   ep->table = eb->tables[type];
    ep->type = type;
    ep->length = length;
+   ep->amplitude = amplitude;
    ep->attacksamples = attacksamples;
    ep->releasesamples = releasesamples;
-
-   float amp = 0;
-   float amplitudeIncrement = 0; // little bit rudandence but structure would be clear
-
-   amplitudeIncrement = amplitude / (float) attacksamples; 
-   for(int i=0;i<attacksamples;i++){
-      ep->data[i] = amp;
-      amp = amp + amplitudeIncrement;
-   }
-
-   amplitudeIncrement = 0;
-   for(int i=attacksamples;i<length-releasesamples;i++){
-      ep->data[i] = amp;
-      amp = amp + amplitudeIncrement;
-   }
-
-   amplitudeIncrement = - amplitude / (float) releasesamples;
-   for(int i=length-releasesamples;i<length;i++){
-      ep->data[i] = amp;
-      amp = amp + amplitudeIncrement;
-   }
+   ep->attackinc = attacksamples > 0 ? ENVELOPETABLESIZE / (float) attacksamples : 0.0f;
+   ep->releaseinc = releasesamples > 0 ? ENVELOPETABLESIZE / (float) releasesamples : 0.0f;
 
    return ep;
 }
 
 
-evelope *evelope_gen_parabolic(evelope* ep, int type, int length, float amplitude){
-   ep = malloc(sizeof(evelope));
-   if (!ep) return NULL;
-
-   ep->data = malloc(sizeof(float) * length);
-   if (!ep->data) return NULL;
+static void evelope_apply_segment(const float *table, float phase, float inc, float amplitude, float *dst, int n){
+   for (int i = 0; i < n; i++){
+      float x = phase + i * inc;
+      int k = (int) x;
+      float f = x - k;
 
-   ep->type = type;
-   ep->length = length;
-   ep->attacksamples = 0;
-   ep->releasesamples = 0;
-
-   float amp = 0;
-   float rdur = 1.0 / (float) length;
-   float rdur2 = rdur * rdur;
-   float slope = 4.0 * amplitude * (rdur - rdur2);
-   float curve = -8.0 * amplitude * rdur2;
-
-   for(int i=0;i<length;i++){
-      ep->data[i] = amp;
-      amp = amp + slope;
-      slope = slope + curve;
+      dst[i] *= amplitude * (table[k] + f * (table[k + 1] - table[k]));
    }
-   return ep;
-
 }
 
 
-evelope *evelope_gen_raised_cosine_bell(evelope* ep, int type, int length, float amplitude, int attacksamples, int releasesamples){
-   // make sure attack and release fit into the length
-   if (attacksamples + releasesamples > length) {
-      attacksamples = length / 2;
-      releasesamples = length / 2;
-   }
-
-   ep = malloc(sizeof(evelope));
-   if (!ep) return NULL;
-
-   ep->data = malloc(sizeof(float) * length);
-   if (!ep->data) return NULL;
-
-   ep->type = type;
-   ep->length = length;
-   ep->attacksamples = attacksamples;
-   ep->releasesamples = releasesamples;
-
-   float amp = 0;
+void evelope_apply(evelope* ep, int pos, float *dst, int n){
+   int end = pos + n;
+   int sustainend = ep->length - ep->releasesamples;
+   int m;
 
-   for(int i=0;i<attacksamples;i++){
-      amp = (1.0 + cos( PI + ( PI * ( i / (float) attacksamples )))) * (amplitude / 2.0);
-      ep->data[i] = amp;
+   // attack, the table is read forward
+   if (pos < ep->attacksamples){
+      m = min(end, ep->attacksamples) - pos;
+      evelope_apply_segment(ep->table, pos * ep->attackinc, ep->attackinc, ep->amplitude, dst, m);
+      dst += m;
+      pos += m;
    }
 
-   for(int i=attacksamples;i<length-releasesamples;i++){
-      amp = amplitude;
-      ep->data[i] = amp;
-   }
-
-
-   for(int i=length-releasesamples;i<length;i++){
-      amp = (1.0 + cos( PI +  PI * ( i / (float) releasesamples ) ) ) * (amplitude / 2.0);
-      ep->data[i] = amp;
+   // sustain
+   if (pos < end && pos < sustainend){
+      m = min(end, sustainend) - pos;
+      for (int i = 0; i < m; i++){
+         dst[i] *= ep->amplitude;
+      }
+      dst += m;
+      pos += m;
    }
 
-   return ep;
-}
-
-
-evelope *evelope_gen_no_evelope(evelope* ep, int type, int length, float amplitude){
-   ep = malloc(sizeof(evelope));
-   if (!ep) return NULL;
-
-   ep->data = malloc(sizeof(float) * length);
-   if (!ep->data) return NULL;
-
-   ep->type = type;
-   ep->length = length;
-   ep->attacksamples = 0;
-   ep->releasesamples = 0;
-
-   for(int i=0;i<length;i++){
-      ep->data[i] = amplitude;
+   // release, the table is read backwards
+   if (pos < end){
+      evelope_apply_segment(ep->table, (ep->length - pos) * ep->releaseinc, -ep->releaseinc, ep->amplitude, dst, end - pos);
    }
-   return ep;
 }
 
 
-evelopbuf *evelopbuf_new(int size){
+evelopbuf *evelopbuf_new(mem_arena *arena){
+   float x;
 
-	evelopbuf *eb = malloc(sizeof(evelopbuf));
+	evelopbuf *eb = mem_arena_alloc(arena, sizeof(evelopbuf));
 	if (!eb) return NULL;
 
-   eb->data = malloc(sizeof(evelope) * size);
-   if (!eb->data) return NULL;
+   for (int type = 0; type < EVELOPE_NUMTYPES; type++){
+      // one extra entry for the end point and one as guard for the interpolation
+      eb->tables[type] = mem_arena_alloc(arena, sizeof(float) * (ENVELOPETABLESIZE + 2));
+      if (!eb->tables[type]) return NULL;
+
+      for (int i = 0; i <= ENVELOPETABLESIZE + 1; i++){
+         x = min(i, ENVELOPETABLESIZE) / (float) ENVELOPETABLESIZE;
+
+         switch (type){
+            case 1:
+               eb->tables[type][i] = 4.0f * x * (1.0f - x);
+               break;
+            case 2:
+               eb->tables[type][i] = x;
+               break;
+            case 3:
+               eb->tables[type][i] = (1.0 + cos( PI + PI * x )) / 2.0;
+               break;
+            default:
+               eb->tables[type][i] = 1.0f;
+         }
+      }
+   }
 
-   eb->size = size;
-   eb->front = 0;
-   eb->rear = 0;
    // post("evelopbuf newed!");
 
    return eb;
 }
 
 
-void evelopbuf_free(evelopbuf *eb){
-	// free every evelopes in the buffer
-   evelope* ep = NULL; // tmp grain saver
-   while (evelopbuf_is_empty(eb) == 0){
-      ep = evelopbuf_pop_evelope(eb, ep);   
-      evelope_free(ep);
-   }
-
-    // free the buffer itself
-   free(eb->data);
-   free(eb);
-   // post("evelopbuf freed!");
-}
-
-
-evelope *evelopbuf_pop_evelope(evelopbuf *eb, evelope* ep){
-   if (evelopbuf_is_empty(eb) == 1){
-      return NULL;
-   }
-   ep = eb->data[eb->front]; 
-      
-   eb->data[eb->front] = NULL;
-
-   eb->front = (eb->front + 1) % eb->size;
-   return ep;
-}
-
-
-void evelopbuf_add_evelope(evelopbuf *eb, int type, int length, int attacksamples, int releasesamples){
-   evelope* ep = NULL;
-
-   if (evelopbuf_is_full(eb) == 1){
-      ep = evelopbuf_pop_evelope(eb, ep);   // remove the earliest added evelope to move space for a new one
-      evelope_free(ep);    
-   }
-   ep = evelope_new(ep, type, length, 0.99,  attacksamples, releasesamples); // todo move this parameters to scheduler
-   // ep = evelope_new(ep, type, length, amplitude, attacksamples, releasesamples);
-   eb->data[eb->rear] = ep;     
-   eb->rear = (eb->rear+ 1) % eb->size;
-}
-
-
 evelope *evelopbuf_check_evelope(evelopbuf *eb, int type, int length, int attacksamples, int releasesamples){
-   evelope* ep = NULL;
-   for (int i = 0; i < evelopbuf_get_len(eb); i++){
-      ep = eb->data[(eb->front + i) % eb->size];
-      if (type == ep->type && length == ep->length){ // todo: use a evelopbuf_compare_evelope() rather than this
-         return ep;
-      }
-   }
-   // if desired evelope not found, add it and return.
-   evelopbuf_add_evelope(eb, type, length,  attacksamples, releasesamples);
-   ep = eb->data[(eb->rear - 1 + eb->size) % eb->size];
-   return ep;
-}
-
-
-int evelopbuf_is_full(evelopbuf *eb){
-   return (eb->rear+1)%eb->size == eb->front?1:0;
-}
-
-
-int evelopbuf_is_empty(evelopbuf *eb){
-   return eb->rear == eb->front?1:0;
-}
-
-
-int evelopbuf_get_len(evelopbuf *eb){
-   return (eb->rear - eb->front + eb->size)%eb->size;
+   return evelope_init(&eb->current, eb, type, length, 0.99,  attacksamples, releasesamples); // todo move this parameters to scheduler
 }
@@ -1,45 +1,442 @@
 #include "goat.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "util/mem.h"
+#include "util/util.h"
 #include "control/manager.h"
 
 
+#define GOAT_REQUEST_RESET -2 /**< the request of a mailbox clear for a reset, a recall requests its slot */
+
+
+static double goat_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief upper bound of the memory an instance takes from its arena
+ * 
+ * Pages of the arena are only backed once they are touched, so the estimate may be generous.
+ */
+static size_t goat_arena_size(goat_config *cfg) {
+    size_t size = ARENABASESIZE;
+
+    size += cfg->delay_size * (cfg->delay_format == CIRCBUF_FORMAT_FLOAT ? sizeof(float) : sizeof(uint16_t));
+    size += cfg->delay_size / PITCHHOPSIZE * 2 * sizeof(double);
+    size += cfg->max_grain_size * NUMSNAPSHOTGRAIN * sizeof(float);
+    size += cfg->num_voices * (sizeof(grain) + sizeof(evelope) + 64);
+    size += MAXTABLESIZE * (sizeof(grain) + sizeof(graintable_entry) + sizeof(int));
+
+    return size;
+}
+
+/**
+ * @brief default maximum length of copied grains in samples
+ * 
+ * Without locking, a copied grain may be as long as the delay line. A locked instance gives its
+ * copied grains what the rest of the instance leaves of the limit of locked memory.
+ */
+static size_t goat_max_grain_size(goat_config *cfg) {
+    size_t limit = mem_lock_limit();
+    size_t used;
+
+    if (!cfg->lock_memory || limit == SIZE_MAX) return cfg->delay_size;
+
+    // the delay line is counted twice, as it may be mapped twice
+    used = goat_arena_size(cfg) + cfg->delay_size * sizeof(float);
+    if (used >= limit) return MINSNAPSHOTGRAINSIZE;
+
+    return (limit - used) / (NUMSNAPSHOTGRAIN * sizeof(float));
+}
+
 goat *goat_new(goat_config *config) {
-    goat *g = malloc(sizeof(goat));
-    if (!g) return NULL;
+    double start = goat_seconds();
+    goat_config cfg;
+    mem_arena *arena;
+    control_parameter *p;
+    int i;
+    goat *g;
+
+    memcpy(&cfg, config, sizeof(goat_config));
+    if (cfg.num_voices <= 0) cfg.num_voices = NUMACTIVEGRAIN;
+    if (cfg.num_voices > MAXACTIVEGRAIN) cfg.num_voices = MAXACTIVEGRAIN;
 
-    memcpy(&g->cfg, config, sizeof(goat_config));
+    if (!is_valid_block_size(cfg.block_size)) cfg.block_size = BLOCKSIZE;
 
-    g->cfg.mgr = control_manager_new();
-    if (!g->cfg.mgr) return NULL;
+    if (cfg.delay_size == 0) cfg.delay_size = DELAYLINESIZE;
+    cfg.delay_size = next_pwrtwo(min(max(cfg.delay_size, MINDELAYLINESIZE), MAXDELAYLINESIZE));
+    if (cfg.delay_format < 0 || cfg.delay_format >= CIRCBUF_FORMAT_COUNT) cfg.delay_format = CIRCBUF_FORMAT_FLOAT;
 
-    g->vd = vd_new(g->cfg.sample_rate);
-    if (!g->vd) return NULL;
+    if (cfg.max_grain_size == 0) cfg.max_grain_size = goat_max_grain_size(&cfg);
+    cfg.max_grain_size = min(max(cfg.max_grain_size, MINSNAPSHOTGRAINSIZE), cfg.delay_size);
+
+    arena = mem_arena_new(goat_arena_size(&cfg));
+    if (!arena) {
+        fprintf(stderr, "goat_new: could not reserve %" PRI_SIZE_T " bytes\n", goat_arena_size(&cfg));
+        return NULL;
+    }
+
+    g = mem_arena_alloc(arena, sizeof(goat));
+    if (!g) goto fail;
+    g->gran = NULL;
+
+    memcpy(&g->cfg, &cfg, sizeof(goat_config));
+    g->cfg.arena = arena;
+
+    g->cfg.mgr = control_manager_new(arena);
+    if (!g->cfg.mgr) goto fail;
+
+    g->vd = vd_new(arena, g->cfg.sample_rate);
+    if (!g->vd) goto fail;
 
     g->modbank = modulator_bank_new(&g->cfg, g->vd);
-    if (!g->modbank) return NULL;
+    if (!g->modbank) goto fail;
 
-    g->gran = granular_new();
-    if (!g->gran) return NULL;
+    g->gran = granular_new(&g->cfg);
+    if (!g->gran) goto fail;
 
     g->schdur = scheduler_new(&g->cfg);
-    if (!g->schdur) return NULL;   
+    if (!g->schdur) goto fail;   
+
+    // the morph covers all parameters, so it comes last
+    g->morph = control_morph_new(g->cfg.mgr, "morph");
+    if (!g->morph) goto fail;
+    atomic_init(&g->morphrequest, -1);
+
+    // every parameter exists now, give them their ids
+    g->numparams = 0;
+    LL_COUNT(g->cfg.mgr->parameters, p, g->numparams);
+
+    g->params = mem_arena_alloc(arena, sizeof(control_parameter *) * g->numparams);
+    if (!g->params) goto fail;
+
+    i = 0;
+    LL_FOREACH(g->cfg.mgr->parameters, p) {
+        p->id = i;
+        g->params[i++] = p;
+    }
+
+    g->mailbox = control_mailbox_new(arena, g->numparams);
+    if (!g->mailbox) goto fail;
+
+    for (i = 0; i < NUMPRESETSNAPSHOTS; i++) {
+        g->snapshots[i] = control_snapshot_new(arena, g->cfg.mgr);
+        if (!g->snapshots[i]) goto fail;
+    }
+    g->recallslot = -1;
+    g->recallclear = 0;
+    atomic_init(&g->recalled, 0);
+    atomic_init(&g->store, 0);
+
+    g->blockin = mem_arena_alloc(arena, sizeof(float) * g->cfg.block_size);
+    if (!g->blockin) goto fail;
+
+    g->blockout = mem_arena_alloc(arena, sizeof(float) * g->cfg.block_size);
+    if (!g->blockout) goto fail;
+
+    g->blockpos = 0;
+
+    g->locked = 0;
+    if (g->cfg.lock_memory) {
+        // the delay line may have a mapping of its own, everything else is in the arena.
+        // Both are faulted in even if locking fails
+        g->locked = circbuf_lock(g->gran->buffer);
+        g->locked &= mem_arena_lock(arena);
+
+        if (!g->locked) fprintf(stderr, "goat_new: could not lock the memory of the instance\n");
+    }
+
+    g->create_time = goat_seconds() - start;
 
     return g;
+
+fail:
+    // the delay line may be mapped outside of the arena
+    if (g && g->gran) granular_free(g->gran);
+    mem_arena_free(arena);
+    return NULL;
 }
 
 void goat_free(goat *g) {
     granular_free(g->gran);
-    vd_free(g->vd);
-    scheduler_free(g->schdur);
-    modulator_bank_free(g->modbank);
-    control_manager_free(g->cfg.mgr);
-    free(g);
+
+    // the goat itself lives in the arena as well
+    mem_arena_free(g->cfg.arena);
+}
+
+/**
+ * @brief take a snapshot of the current state, values that were queued but not applied yet included
+ */
+static void goat_snapshot_capture(goat *g, control_snapshot *snap) {
+    float value;
+
+    // the entries of the snapshot are in list order, which is the order of the ids
+    control_snapshot_capture(snap, g->cfg.mgr);
+    for (int id = 0; id < g->numparams; id++) {
+        if (control_mailbox_peek(g->mailbox, id, &value)) snap->entries[id].offset = value;
+    }
 }
 
 void goat_perform(goat *g, float *in, float *out, int n) {
+    unsigned int stores;
+    int slot, request;
+#ifdef DEBUG
+    size_t heapcalls = mem_heapcalls;
+#endif
+
+    // snapshots are taken before anything else changes, so a store followed by a recall keeps the current state.
+    // A slot is released only once it has been written
+    stores = atomic_load_explicit(&g->store, memory_order_acquire);
+    for (; stores; stores &= stores - 1) {
+        slot = util_ctz(stores);
+        goat_snapshot_capture(g, g->snapshots[slot]);
+        atomic_fetch_and_explicit(&g->store, ~(1u << slot), memory_order_release);
+    }
+
+    // a reset or a recalled snapshot replaces the whole control state at the block boundary. It comes with a clear
+    // of the mailbox, so it happens after the updates queued before it and before those queued after it.
+    // The slot of a recall must not change until it has been read
+    request = control_mailbox_fetch(g->mailbox);
+    if (request == GOAT_REQUEST_RESET) {
+        control_manager_reset(g->cfg.mgr);
+    } else if (request >= 0) {
+        control_morph_stop(g->morph);
+        control_snapshot_apply(g->snapshots[request], g->cfg.mgr);
+    }
+    if (request != CONTROL_MAILBOX_NOREQUEST) atomic_store_explicit(&g->recalled, g->mailbox->fetchedclears, memory_order_release);
+
+    slot = atomic_load_explicit(&g->morphrequest, memory_order_acquire);
+    if (slot != -1) {
+        if (slot >= 0) control_morph_load(g->morph, g->snapshots[slot / NUMPRESETSNAPSHOTS], g->snapshots[slot % NUMPRESETSNAPSHOTS]);
+        else if (slot == -2) control_morph_stop(g->morph);
+        atomic_compare_exchange_strong_explicit(&g->morphrequest, &slot, -1, memory_order_release, memory_order_relaxed);
+    }
+
+    control_mailbox_apply(g->mailbox, g->params);
     control_manager_perform(g->cfg.mgr, in, n);
     vd_perform(g->vd, in, n);
     scheduler_perform(g->schdur, n);
     granular_perform(g->gran, g->schdur, g->vd, in, out, n); // update the buffer and manipulate the DelayLine
+
+#ifdef DEBUG
+    // the audio thread must never touch the heap
+    if (mem_heapcalls != heapcalls) {
+        fprintf(stderr, "goat_perform: %" PRI_SIZE_T " heap calls in a single block\n", mem_heapcalls - heapcalls);
+    }
+#endif
+}
+
+void goat_process(goat *g, float *in, float *out, size_t frames) {
+    size_t n = g->cfg.block_size;
+    size_t i = 0, chunk;
+
+    // the output is one block behind the input, so the latency does not depend on how the caller splits the stream
+    while (i < frames) {
+        chunk = min(frames - i, n - g->blockpos);
+
+        memcpy(&g->blockin[g->blockpos], &in[i], sizeof(float) * chunk);
+        memcpy(&out[i], &g->blockout[g->blockpos], sizeof(float) * chunk);
+
+        g->blockpos += chunk;
+        i += chunk;
+
+        if (g->blockpos == n) {
+            goat_perform(g, g->blockin, g->blockout, n);
+            g->blockpos = 0;
+        }
+    }
+}
+
+
+int goat_param_count(goat *g) {
+    return g->numparams;
+}
+
+int goat_param_id(goat *g, const char *name) {
+    control_parameter *p = control_manager_parameter_by_name(g->cfg.mgr, name);
+    return p ? p->id : -1;
+}
+
+const char *goat_param_name(goat *g, int id) {
+    if (id < 0 || id >= g->numparams) return NULL;
+    return g->params[id]->name;
+}
+
+void goat_param_set(goat *g, int id, float value) {
+    if (id < 0 || id >= g->numparams) {
+        fprintf(stderr, "goat_param_set: parameter id out of range (%d >= %d)\n", id, g->numparams);
+        return;
+    }
+
+    control_parameter_set(g->params[id], value);
+}
+
+float goat_param_get(goat *g, int id) {
+    if (id < 0 || id >= g->numparams) {
+        fprintf(stderr, "goat_param_get: parameter id out of range (%d >= %d)\n", id, g->numparams);
+        return 0.0f;
+    }
+
+    return control_parameter_get_float(g->params[id]);
+}
+
+void goat_param_queue(goat *g, int id, float value) {
+    goat_param_queue_list(g, &id, &value, 1);
+}
+
+void goat_param_queue_list(goat *g, const int *ids, const float *values, int count) {
+    for (int i = 0; i < count; i++) {
+        if (ids[i] < 0 || ids[i] >= g->numparams) {
+            fprintf(stderr, "goat_param_queue: skipping parameter id out of range (%d >= %d)\n", ids[i], g->numparams);
+        }
+    }
+
+    // the mailbox skips the invalid ids, the others are still applied in the same block
+    control_mailbox_post(g->mailbox, ids, values, count);
+}
+
+/**
+ * @brief validate the parameter and slot of a routing change and post it
+ */
+static int goat_param_route(goat *g, const char *func, control_route *route) {
+    if (route->id < 0 || route->id >= g->numparams) {
+        fprintf(stderr, "%s: parameter id out of range (%d >= %d)\n", func, route->id, g->numparams);
+        return 0;
+    }
+
+    if (route->slot < 0 || route->slot >= CONTROL_NUM_SLOTS) {
+        fprintf(stderr, "%s: slot out of range (%d >= %d)\n", func, route->slot, CONTROL_NUM_SLOTS);
+        return 0;
+    }
+
+    if (!control_mailbox_route(g->mailbox, route)) {
+        fprintf(stderr, "%s: too many changes are waiting for the next block\n", func);
+        return 0;
+    }
+
+    return 1;
+}
+
+int goat_param_queue_attach(goat *g, int id, int slot, const char *modname) {
+    control_route route = {.type = CONTROL_ROUTE_ATTACH, .id = id, .slot = slot};
+
+    route.mod = control_manager_modulator_by_name(g->cfg.mgr, modname);
+    if (!route.mod) {
+        fprintf(stderr, "goat_param_queue_attach: unknown modulator %s\n", modname);
+        return 0;
+    }
+
+    return goat_param_route(g, "goat_param_queue_attach", &route);
+}
+
+int goat_param_queue_detach(goat *g, int id, int slot) {
+    control_route route = {.type = CONTROL_ROUTE_DETACH, .id = id, .slot = slot};
+    return goat_param_route(g, "goat_param_queue_detach", &route);
+}
+
+int goat_param_queue_amount(goat *g, int id, int slot, float amount) {
+    control_route route = {.type = CONTROL_ROUTE_AMOUNT, .id = id, .slot = slot, .amount = amount};
+    return goat_param_route(g, "goat_param_queue_amount", &route);
+}
+
+void goat_param_reset(goat *g) {
+    // values that were queued before the reset must not be applied after it
+    control_mailbox_clear(g->mailbox, GOAT_REQUEST_RESET);
+}
+
+
+static int goat_validate_snapshot(const char *func, int slot) {
+    if (slot < 0 || slot >= NUMPRESETSNAPSHOTS) {
+        fprintf(stderr, "%s: snapshot slot out of range (%d >= %d)\n", func, slot, NUMPRESETSNAPSHOTS);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief check that the audio thread does not write a slot, because it is about to store it
+ */
+static int goat_snapshot_stored(goat *g, const char *func, int slot) {
+    if ((atomic_load_explicit(&g->store, memory_order_acquire) >> slot) & 1) {
+        fprintf(stderr, "%s: snapshot slot %d is stored in the next block, try again afterwards\n", func, slot);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief check that the audio thread does not read a slot, because a recall or morph of it is pending
+ */
+static int goat_snapshot_idle(goat *g, const char *func, int slot) {
+    int morph = atomic_load_explicit(&g->morphrequest, memory_order_acquire);
+
+    if ((slot == g->recallslot && (int) (g->recallclear - atomic_load_explicit(&g->recalled, memory_order_acquire)) > 0)
+            || (morph >= 0 && (morph / NUMPRESETSNAPSHOTS == slot || morph % NUMPRESETSNAPSHOTS == slot))) {
+        fprintf(stderr, "%s: snapshot slot %d is recalled or morphed in the next block, try again afterwards\n", func, slot);
+        return 0;
+    }
+
+    return goat_snapshot_stored(g, func, slot);
+}
+
+int goat_snapshot_store(goat *g, int slot) {
+    if (!goat_validate_snapshot("goat_snapshot_store", slot)) return 0;
+
+    // the state belongs to the audio thread, it takes the snapshot at the start of the next block
+    atomic_fetch_or_explicit(&g->store, 1u << slot, memory_order_release);
+
+    return 1;
+}
+
+int goat_snapshot_recall(goat *g, int slot) {
+    if (!goat_validate_snapshot("goat_snapshot_recall", slot)) return 0;
+    if (!goat_snapshot_stored(g, "goat_snapshot_recall", slot)) return 0;
+
+    if (!g->snapshots[slot]->valid) {
+        fprintf(stderr, "goat_snapshot_recall: snapshot slot %d is empty\n", slot);
+        return 0;
+    }
+
+    // the audio thread reads the slot once it fetches the clear
+    g->recallslot = slot;
+    g->recallclear = control_mailbox_clear(g->mailbox, slot);
+
+    return 1;
+}
+
+int goat_morph(goat *g, int from, int to) {
+    if (!goat_validate_snapshot("goat_morph", from) || !goat_validate_snapshot("goat_morph", to)) return 0;
+    if (!goat_snapshot_stored(g, "goat_morph", from) || !goat_snapshot_stored(g, "goat_morph", to)) return 0;
+
+    if (!g->snapshots[from]->valid || !g->snapshots[to]->valid) {
+        fprintf(stderr, "goat_morph: snapshot slot %d is empty\n", g->snapshots[from]->valid ? to : from);
+        return 0;
+    }
+
+    atomic_store_explicit(&g->morphrequest, from * NUMPRESETSNAPSHOTS + to, memory_order_release);
+
+    return 1;
+}
+
+void goat_morph_stop(goat *g) {
+    atomic_store_explicit(&g->morphrequest, -2, memory_order_release);
+}
+
+int goat_snapshot_read(goat *g, int slot, const char *path) {
+    if (!goat_validate_snapshot("goat_snapshot_read", slot)) return -1;
+    if (!goat_snapshot_idle(g, "goat_snapshot_read", slot)) return -1;
+    return control_snapshot_load(g->snapshots[slot], g->cfg.mgr, path);
+}
+
+int goat_snapshot_write(goat *g, int slot, const char *path) {
+    if (!goat_validate_snapshot("goat_snapshot_write", slot)) return 0;
+    if (!goat_snapshot_stored(g, "goat_snapshot_write", slot)) return 0;
+    return control_snapshot_save(g->snapshots[slot], g->cfg.mgr, path);
 }
@@ -7,7 +7,7 @@
 static t_class *goat_tilde_class;
 
 
-void *goat_tilde_new(void) {
+void *goat_tilde_new(t_floatarg voices, t_floatarg delay, t_floatarg format, t_floatarg lock, t_floatarg grainsize) {
     goat_tilde *x = (goat_tilde *) pd_new(goat_tilde_class);
     if (!x) return NULL;
 
@@ -19,9 +19,21 @@ void *goat_tilde_new(void) {
 
     goat_config config = {
         .sample_rate = (size_t) sys_getsr(),
-        .block_size = sys_getblksize()
+        .block_size = sys_getblksize(),
+        .num_voices = (int) voices,
+        .delay_size = (size_t) (max(delay, 0.0f) * sys_getsr()),
+        .delay_format = (int) format,
+        .lock_memory = lock != 0.0f,
+        .max_grain_size = (size_t) (max(grainsize, 0.0f) * sys_getsr())
     };
     x->g = goat_new(&config);
+    if (!x->g) return NULL;
+
+    x->canvas = canvas_getcurrent();
+
+    if (config.lock_memory && !x->g->locked) {
+        error("goat~: could not lock the memory, the buffers are prefaulted but may be swapped out. Check the memlock limit (ulimit -l)");
+    }
 
     return (void *) x;
 }
@@ -44,6 +56,14 @@ static control_modulator *goat_tilde_validate_modulator(goat_tilde *x, const cha
     return mod;
 }
 
+static control_parameter *goat_tilde_validate_parameter_id(goat_tilde *x, int id) {
+    if (id < 0 || id >= goat_param_count(x->g)) {
+        error("goat~: parameter id %d out of range", id);
+        return NULL;
+    }
+    return x->g->params[id];
+}
+
 static int goat_tilde_validate_slot(int slot) {
     if (slot < 0 || slot >= CONTROL_NUM_SLOTS) {
         error("goat~: slot %d out of range", slot);
@@ -54,10 +74,10 @@ static int goat_tilde_validate_slot(int slot) {
 
 void goat_tilde_graintable_get(goat_tilde *x) {
     granular *gran = x->g->gran;
+    synthesizer *syn = gran->synth;
     int buffersize = gran->buffer->size;
     int writepos = gran->buffer->writetap.position;
     grain *gn;
-    activategrain *agn;
 
     int i;
     int argc = 4;
@@ -67,7 +87,7 @@ void goat_tilde_graintable_get(goat_tilde *x) {
 
     // inactive grains
     for (i = 0; i < graintable_get_len(gran->grains); i++) {
-        gn = &gran->grains->data[(gran->grains->front+i) % gran->grains->size];
+        gn = &gran->grains->data[gran->grains->heap[i].slot];
 
         SETFLOAT(&argv[0], 0); // inactive
         SETFLOAT(&argv[1], CIRCBUF_DIST(gn->position, writepos, buffersize)
@@ -79,10 +99,9 @@ void goat_tilde_graintable_get(goat_tilde *x) {
     }
 
     // active grains
-    for (i = 0; i < gran->synth->length; i++) {
-        agn = gran->synth->data[i];
-        if (agn == NULL) continue;
-        gn = &agn->origin;
+    for (i = 0; i < syn->length; i++) {
+        if (!SYNTH_IS_LIVE(syn, i)) continue;
+        gn = &syn->origin[i];
 
         SETFLOAT(&argv[0], 1); // active
         SETFLOAT(&argv[1], CIRCBUF_DIST(gn->position, writepos, buffersize)
@@ -96,6 +115,7 @@ void goat_tilde_graintable_get(goat_tilde *x) {
 
 void goat_tilde_param_get(goat_tilde *x, t_symbol *paramname) {
     control_parameter *param;
+    float value;
 
     // get all parameters
     if (paramname == NULL || paramname->s_name == NULL || paramname->s_name[0] == '\0') {
@@ -108,10 +128,13 @@ void goat_tilde_param_get(goat_tilde *x, t_symbol *paramname) {
 
     if ((param = goat_tilde_validate_parameter(x, paramname->s_name)) == NULL) return;
 
+    // a value that was set but not yet applied by the dsp is reported as well
+    if (!control_mailbox_peek(x->g->mailbox, param->id, &value)) value = param->offset;
+
     int argc = 2;
     t_atom argv[argc];
     SETSYMBOL(&argv[0], paramname);
-    SETFLOAT(&argv[1], param->offset);
+    SETFLOAT(&argv[1], value);
     outlet_anything(x->dataout, gensym("param-get"), argc, argv);
 }
 
@@ -119,7 +142,92 @@ void goat_tilde_param_set(goat_tilde *x, t_symbol *paramname, t_float value) {
     control_parameter *param;
     if ((param = goat_tilde_validate_parameter(x, paramname->s_name)) == NULL) return;
 
-    control_parameter_set(param, value);
+    goat_param_queue(x->g, param->id, value);
+}
+
+void goat_tilde_param_set_id(goat_tilde *x, t_float id, t_float value) {
+    control_parameter *param;
+    if ((param = goat_tilde_validate_parameter_id(x, (int) id)) == NULL) return;
+
+    goat_param_queue(x->g, param->id, value);
+}
+
+void goat_tilde_param_set_list(goat_tilde *x, __attribute__((unused)) t_symbol *s, int argc, t_atom *argv) {
+    control_parameter *param;
+    int ids[argc / 2 + 1];
+    float values[argc / 2 + 1];
+    int count = 0;
+
+    if (argc % 2) error("goat~: param-set-list expects pairs of parameter and value, the last atom is ignored");
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        // parameters may be given by name or id
+        if (argv[i].a_type == A_FLOAT) param = goat_tilde_validate_parameter_id(x, (int) atom_getfloat(&argv[i]));
+        else param = goat_tilde_validate_parameter(x, atom_getsymbol(&argv[i])->s_name);
+        if (param == NULL) continue;
+
+        ids[count] = param->id;
+        values[count] = atom_getfloat(&argv[i + 1]);
+        count++;
+    }
+
+    goat_param_queue_list(x->g, ids, values, count);
+}
+
+void goat_tilde_param_id(goat_tilde *x, t_symbol *paramname) {
+    control_parameter *param;
+
+    // get the ids of all parameters
+    if (paramname == NULL || paramname->s_name == NULL || paramname->s_name[0] == '\0') {
+        for (int i = 0; i < goat_param_count(x->g); i++) {
+            goat_tilde_param_id(x, gensym(goat_param_name(x->g, i)));
+        }
+
+        return;
+    }
+
+    if ((param = goat_tilde_validate_parameter(x, paramname->s_name)) == NULL) return;
+
+    int argc = 2;
+    t_atom argv[argc];
+    SETSYMBOL(&argv[0], paramname);
+    SETFLOAT(&argv[1], param->id);
+    outlet_anything(x->dataout, gensym("param-id"), argc, argv);
+}
+
+void goat_tilde_snapshot_store(goat_tilde *x, t_float slot) {
+    if (!goat_snapshot_store(x->g, (int) slot)) error("goat~: snapshot slot %d out of range", (int) slot);
+}
+
+void goat_tilde_snapshot_recall(goat_tilde *x, t_float slot) {
+    if (!goat_snapshot_recall(x->g, (int) slot)) error("goat~: snapshot slot %d is out of range, empty or not stored yet", (int) slot);
+}
+
+void goat_tilde_snapshot_read(goat_tilde *x, t_float slot, t_symbol *filename) {
+    char path[MAXPDSTRING];
+    int unknown;
+
+    canvas_makefilename(x->canvas, filename->s_name, path, MAXPDSTRING);
+
+    unknown = goat_snapshot_read(x->g, (int) slot, path);
+    if (unknown < 0) error("goat~: could not read snapshot %s", path);
+    else if (unknown > 0) error("goat~: snapshot %s contains %d unknown names", path, unknown);
+}
+
+void goat_tilde_snapshot_write(goat_tilde *x, t_float slot, t_symbol *filename) {
+    char path[MAXPDSTRING];
+
+    canvas_makefilename(x->canvas, filename->s_name, path, MAXPDSTRING);
+
+    if (!goat_snapshot_write(x->g, (int) slot, path)) error("goat~: could not write snapshot slot %d to %s", (int) slot, path);
+}
+
+void goat_tilde_morph(goat_tilde *x, t_float from, t_float to) {
+    if (!goat_morph(x->g, (int) from, (int) to)) error("goat~: snapshot slots %d and %d must be stored before morphing", (int) from, (int) to);
+}
+
+void goat_tilde_morph_stop(goat_tilde *x) {
+    goat_morph_stop(x->g);
 }
 
 void goat_tilde_param_amount(goat_tilde *x, t_symbol *paramname, t_float fslot, t_float value) {
@@ -129,7 +237,7 @@ void goat_tilde_param_amount(goat_tilde *x, t_symbol *paramname, t_float fslot,
     if ((param = goat_tilde_validate_parameter(x, paramname->s_name)) == NULL) return;
     if ((slot = goat_tilde_validate_slot(fslot)) == -1) return;
 
-    control_parameter_amount(param, slot, value);
+    if (!goat_param_queue_amount(x->g, param->id, slot, value)) error("goat~: too many changes, param-amount is ignored");
 }
 
 void goat_tilde_param_attach(goat_tilde *x, __attribute__((unused)) t_symbol *s, int argc, t_atom *argv) {
@@ -145,12 +253,8 @@ void goat_tilde_param_attach(goat_tilde *x, __attribute__((unused)) t_symbol *s,
     if ((mod = goat_tilde_validate_modulator(x, modname->s_name)) == NULL) return;
     if ((slot = goat_tilde_validate_slot(fslot)) == -1) return;
 
-    if (param->slots[slot].mod == mod) {
-        error("goat~: already attached");
-        return;
-    }
-
-    control_parameter_attach(param, slot, mod);
+    // the slots belong to the audio thread, the change is applied at the start of the next block
+    if (!goat_param_queue_attach(x->g, param->id, slot, mod->name)) error("goat~: too many changes, param-attach is ignored");
 }
 
 void goat_tilde_param_detach(goat_tilde *x, t_symbol *paramname, t_floatarg fslot) {
@@ -160,12 +264,7 @@ void goat_tilde_param_detach(goat_tilde *x, t_symbol *paramname, t_floatarg fslo
     if ((param = goat_tilde_validate_parameter(x, paramname->s_name)) == NULL) return;
     if ((slot = goat_tilde_validate_slot(fslot)) == -1) return;
 
-    if (param->slots[slot].mod == NULL) {
-        error("goat~: already detached");
-        return;
-    }
-
-    control_parameter_detach(param, slot);
+    if (!goat_param_queue_detach(x->g, param->id, slot)) error("goat~: too many changes, param-detach is ignored");
 }
 
 void goat_tilde_param_post(goat_tilde *x) {
@@ -189,20 +288,38 @@ void goat_tilde_param_post(goat_tilde *x) {
     }
 }
 
-void goat_tilde_param_reset(goat_tilde *x){
-    control_parameter *p;
-    int i;
+void goat_tilde_stats_post(goat_tilde *x) {
+    synthesizer *syn = x->g->gran->synth;
+    control_manager *mgr = x->g->cfg.mgr;
+    control_modulator *m;
+    int nummods;
+
+    post("INSTANCE:");
+    post("    created in %.3f ms", x->g->create_time * 1e3);
+    post("    arena: %" PRI_SIZE_T " of %" PRI_SIZE_T " bytes reserved, %s",
+        x->g->cfg.arena->used,
+        x->g->cfg.arena->size,
+        x->g->cfg.arena->mapped ? "mapped" : "calloc");
+    post("    memory: %s", !x->g->cfg.lock_memory ? "not locked" : x->g->locked ? "prefaulted and locked" : "prefaulted, locking failed");
+    post("    copied grains: up to %" PRI_SIZE_T " samples", x->g->cfg.max_grain_size);
+    post("VOICE POOL:");
+    post("    voices: %d playing, %d free of %d", syn->numlive, syn->numfree, syn->length);
+    post("    snapshots: %d free of %d", syn->numsnapshotsfree, syn->numsnapshots);
+    post("    acquired: %" PRI_SIZE_T ", released: %" PRI_SIZE_T ", dropped: %" PRI_SIZE_T,
+        syn->numacquired,
+        syn->numreleased,
+        syn->numdropped);
+    post("    invalid grains: %" PRI_SIZE_T, x->g->gran->grains->numinvalid);
+    LL_COUNT(mgr->modulators, m, nummods);
+    post("CONTROL:");
+    post("    modulators: %d running, %d idle", mgr->numactive, nummods - mgr->numactive);
+#ifdef DEBUG
+    post("    heap calls: %" PRI_SIZE_T, mem_heapcalls);
+#endif
+}
 
-    LL_FOREACH(x->g->cfg.mgr->parameters, p) {
-        p->offset=p->reset;
-        p->value=p->reset;
-        for (i = 0; i < CONTROL_NUM_SLOTS; i++) {
-            if (p->slots[i].mod) {
-                control_parameter_amount(p,i,1.0f);
-                control_parameter_detach(p,i);
-            }
-        }
-    }
+void goat_tilde_param_reset(goat_tilde *x){
+    goat_param_reset(x->g);
     // post("DEFAULTS:");
     // goat_tilde_param_post(x);
 }
@@ -213,8 +330,13 @@ static t_int *goat_tilde_perform(t_int *w) {
     t_sample *out = (t_sample *) w[3];
     int n = (int) w[4];
 
-    // invoke the main algorithm
-    goat_perform(x->g, in, out, n);
+    // invoke the main algorithm. The vector size is the same for every call, so is the latency:
+    // whole blocks are processed in place, other sizes are re-blocked by the engine with a delay of one block
+    if (n % x->g->cfg.block_size == 0) {
+        for (int i = 0; i < n; i += x->g->cfg.block_size) goat_perform(x->g, &in[i], &out[i], x->g->cfg.block_size);
+    } else {
+        goat_process(x->g, in, out, n);
+    }
 
     return &w[5];
 }
@@ -229,10 +351,16 @@ void goat_tilde_dsp(goat_tilde *x, t_signal **sp) {
 
 void goat_tilde_setup(void) {
     goat_tilde_class = class_new(gensym("goat~"),
-        (t_newmethod) goat_tilde_new,
+        // cast through a generic function pointer, pd calls the constructor with the creation arguments
+        (t_newmethod) (void (*)(void)) goat_tilde_new,
         (t_method) goat_tilde_free,
         sizeof(goat_tilde),
         CLASS_DEFAULT,
+        A_DEFFLOAT,
+        A_DEFFLOAT,
+        A_DEFFLOAT,
+        A_DEFFLOAT,
+        A_DEFFLOAT,
         0);
     
     class_addmethod(goat_tilde_class,
@@ -251,6 +379,22 @@ void goat_tilde_setup(void) {
         A_SYMBOL,
         A_FLOAT,
         A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_param_set_id,
+        gensym("param-set-id"),
+        A_FLOAT,
+        A_FLOAT,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_param_set_list,
+        gensym("param-set-list"),
+        A_GIMME,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_param_id,
+        gensym("param-id"),
+        A_DEFSYMBOL,
+        A_NULL);
     class_addmethod(goat_tilde_class,
         (t_method) goat_tilde_param_amount,
         gensym("param-amount"),
@@ -279,6 +423,42 @@ void goat_tilde_setup(void) {
         (t_method) goat_tilde_param_reset,
         gensym("param-reset"),
         A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_snapshot_store,
+        gensym("snapshot-store"),
+        A_FLOAT,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_snapshot_recall,
+        gensym("snapshot-recall"),
+        A_FLOAT,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_snapshot_read,
+        gensym("snapshot-read"),
+        A_FLOAT,
+        A_SYMBOL,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_snapshot_write,
+        gensym("snapshot-write"),
+        A_FLOAT,
+        A_SYMBOL,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_morph,
+        gensym("morph"),
+        A_FLOAT,
+        A_FLOAT,
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_morph_stop,
+        gensym("morph-stop"),
+        A_NULL);
+    class_addmethod(goat_tilde_class,
+        (t_method) goat_tilde_stats_post,
+        gensym("stats-post"),
+        A_NULL);
 
     class_addmethod(goat_tilde_class,
         (t_method) goat_tilde_dsp,
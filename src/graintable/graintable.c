@@ -5,9 +5,9 @@
 #include "util/mem.h"
 #include "util/util.h"
 
-grain *grain_init(grain *gn, circbuf *cb, circbuf *pb, float position, float duration, float delay, float speed, size_t max_timeout, int evelope){
+grain *grain_init(grain *gn, circbuf *cb, pitchtimeline *pt, float position, float duration, float delay, float speed, size_t max_timeout, int evelope, uint64_t birth){
     gn->cb = cb;
-    gn->pb = pb;
+    gn->pt = pt;
 
     gn->position = position;
     gn->duration = duration;
@@ -15,7 +15,7 @@ grain *grain_init(grain *gn, circbuf *cb, circbuf *pb, float position, float dur
     gn->speed = speed;
     gn->timeout = min(max_timeout, (size_t) (delay + duration / speed));
     gn->evelope  = evelope;
-    gn->lifetime  = 0;
+    gn->birth = birth;
 
     // size of the internal grain buffer (used by the active grain and envelope buffer)
     gn->gb_size = min(cb->size, (size_t) (gn->duration * gn->speed + 1.0f));
@@ -25,55 +25,97 @@ grain *grain_init(grain *gn, circbuf *cb, circbuf *pb, float position, float dur
 
 
 void grain_post_feature(grain *gn){
-    printf("features: \n position: %f | \t duration: %f | \t delay: %f | \t speed: %f | \t evelope: %d | \t lifetime: %" PRI_SIZE_T " | \t timeout %" PRI_SIZE_T "\n",
+    printf("features: \n position: %f | \t duration: %f | \t delay: %f | \t speed: %f | \t evelope: %d | \t birth: %" PRIu64 " | \t timeout %" PRI_SIZE_T "\n",
         gn->position,
         gn->duration,
         gn->delay,
         gn->speed,
         gn->evelope,
-        gn->lifetime,
+        gn->birth,
         gn->timeout);
 }
 
 
-void grain_update_lifetime(grain *gn, int n){
-    gn->lifetime += n;
+float grain_get_start(grain *gn, uint64_t now){
+    // the difference is signed, grains that are overdue start right away
+    return max((float) (int64_t) (gn->birth - now) + gn->delay, 0.0f);
 }
 
 
-graintable *graintable_new(int size){
-    graintable *gt = malloc(sizeof(graintable));
+double grain_get_due(grain *gn){
+    return (double) gn->birth + gn->delay;
+}
+
+
+graintable *graintable_new(mem_arena *arena, int size){
+    graintable *gt = mem_arena_alloc(arena, sizeof(graintable));
     if (!gt) return NULL;
 
-    gt->data = malloc(sizeof(grain) * size);
+    gt->data = mem_arena_alloc(arena, sizeof(grain) * size);
     if (!gt->data) return NULL;
 
+    gt->heap = mem_arena_alloc(arena, sizeof(graintable_entry) * size);
+    if (!gt->heap) return NULL;
+
+    gt->freeslots = mem_arena_alloc(arena, sizeof(int) * size);
+    if (!gt->freeslots) return NULL;
+
+    for (int i = 0; i < size; i++){
+        gt->freeslots[i] = size - 1 - i;
+    }
+
     gt->size = size;
-    gt->front = 0;
-    gt->rear = 0;
+    gt->len = 0;
+    gt->numfree = size;
+    gt->numinvalid = 0;
 
     return gt;
 }
 
 
-void graintable_free(graintable *gt){
-    // free the buffer itself
-    free(gt->data);
-    free(gt);
+int graintable_is_full(graintable *gt){
+    return gt->numfree == 0?1:0;
 }
 
 
-int graintable_is_full(graintable *gt){
-    return (gt->rear+1)%gt->size == gt->front?1:0;
+int graintable_is_empty(graintable *gt){
+    return gt->len == 0?1:0;
 }
 
 
-int graintable_is_empty(graintable *gt){
-    return gt->rear == gt->front?1:0;
+static void graintable_sift_up(graintable *gt, int i){
+    graintable_entry entry = gt->heap[i];
+    int parent;
+
+    while (i > 0){
+        parent = (i - 1) / 2;
+        if (gt->heap[parent].due <= entry.due) break;
+
+        gt->heap[i] = gt->heap[parent];
+        i = parent;
+    }
+
+    gt->heap[i] = entry;
 }
 
 
-void graintable_add_grain(graintable *gt, circbuf *cb, circbuf *pb, float position, float duration, float delay, float speed, int evelope){  
+static void graintable_sift_down(graintable *gt, int i){
+    graintable_entry entry = gt->heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < gt->len){
+        if (child + 1 < gt->len && gt->heap[child + 1].due < gt->heap[child].due) child++;
+        if (entry.due <= gt->heap[child].due) break;
+
+        gt->heap[i] = gt->heap[child];
+        i = child;
+    }
+
+    gt->heap[i] = entry;
+}
+
+
+void graintable_add_grain(graintable *gt, circbuf *cb, pitchtimeline *pt, float position, float duration, float delay, float speed, int evelope, uint64_t birth){  
     if (graintable_is_full(gt) == 1){
         return;
     }
@@ -81,22 +123,27 @@ void graintable_add_grain(graintable *gt, circbuf *cb, circbuf *pb, float positi
     // do not create grains with invalid durations
     float actualduration = duration / speed;
     if (actualduration < 2.0f || actualduration >= cb->size) {
-        fprintf(stderr, "graintable: invalid grain duration: %f\n", actualduration);
+        gt->numinvalid++;
         return;
     }
 
     size_t max_timeout = (size_t) (cb->size - delay - duration / speed);
+    int slot = gt->freeslots[--gt->numfree];
 
-    grain_init(&gt->data[gt->rear],
+    grain_init(&gt->data[slot],
         cb,
-        pb,
+        pt,
         position,
         duration,
         delay,
         speed,
         max_timeout,
-        evelope);       
-    gt->rear = (gt->rear+ 1) % gt->size;    
+        evelope,
+        birth);
+
+    gt->heap[gt->len].due = grain_get_due(&gt->data[slot]);
+    gt->heap[gt->len].slot = slot;
+    graintable_sift_up(gt, gt->len++);
 }
 
 
@@ -105,7 +152,7 @@ grain *graintable_peek_grain(graintable *gt){
         return NULL;
     }
 
-    return &gt->data[gt->front];
+    return &gt->data[gt->heap[0].slot];
 }
 
 
@@ -115,37 +162,34 @@ grain *graintable_pop_grain(graintable *gt){
     if (graintable_is_empty(gt) == 1){
         return NULL;
     }
-    gn = &gt->data[gt->front]; 
+    gn = &gt->data[gt->heap[0].slot]; 
+    gt->freeslots[gt->numfree++] = gt->heap[0].slot;
+
+    // move the last entry to the root and restore the heap order
+    gt->heap[0] = gt->heap[--gt->len];
+    if (gt->len > 0) graintable_sift_down(gt, 0);
 
     // grain_post_feature(gn);
-    gt->front = (gt->front + 1) % gt->size;
     return gn;
 }
 
 
 int graintable_get_len(graintable *gt){
-    return (gt->rear - gt->front + gt->size)%gt->size;
+    return gt->len;
 }
 
 
 void graintable_check_grain(graintable *gt, __attribute__((unused)) grain *gn, int delay){
     if (graintable_get_len(gt) <=  delay || delay < 0){
-        error("graintable_check_grain: trying to check a grain out of current table range\n");
+        fprintf(stderr, "graintable_check_grain: trying to check a grain out of current table range\n");
         return;
     }
 }
 
 
-void graintable_update_lifetime(graintable *gt, int n){
-    for (int i = 0; i < graintable_get_len(gt); i++){
-        grain_update_lifetime(&gt->data[(gt->front+i) % gt->size], n);
-    }
-}
-
-
 void graintable_print_all(graintable *gt){
     for (int i = 0; i < graintable_get_len(gt); i++){
-        grain_post_feature(&gt->data[(gt->front+i) % gt->size]);
+        grain_post_feature(&gt->data[gt->heap[i].slot]);
     }
 }
 
@@ -1,79 +1,91 @@
 #include "granular/granular.h"
 
+#include <math.h>
 #include "util/mem.h"
 #include "params.h"
 
-granular *granular_new(void) {
-    granular *g = malloc(sizeof(granular));
+granular *granular_new(goat_config *cfg) {
+    granular *g = mem_arena_alloc(cfg->arena, sizeof(granular));
     if (!g) return NULL;
 
-    g->buffer = circbuf_new(DELAYLINESIZE, NUMACTIVEGRAIN);
+    g->buffer = circbuf_new(cfg->arena, cfg->delay_size, 1, cfg->delay_format);
     if (!g->buffer) return NULL;
-    for (size_t i = 0; i < g->buffer->size; i++) g->buffer->data[i] = 0.0f;
 
-    g->pitchbuffer = circbuf_new(DELAYLINESIZE, NUMACTIVEGRAIN);
-    if (!g->pitchbuffer) return NULL;
-    for (size_t i = 0; i < g->pitchbuffer->size; i++) g->pitchbuffer->data[i] = 0.0f;
+    g->pitch = pitchtimeline_new(cfg->arena, cfg->delay_size, PITCHHOPSIZE);
+    if (!g->pitch) goto fail;
 
-    g->grains = graintable_new(MAXTABLESIZE); 
-    if (!g->grains) return NULL;
+    g->grains = graintable_new(cfg->arena, MAXTABLESIZE); 
+    if (!g->grains) goto fail;
 
-    g->evelopes = evelopbuf_new(ENVELOPEBUFSIZE); 
-    if (!g->evelopes) return NULL;
+    g->evelopes = evelopbuf_new(cfg->arena); 
+    if (!g->evelopes) goto fail;
 
-    g->synth = synthesizer_new(NUMACTIVEGRAIN);
-    if (!g->synth) return NULL;
+    g->synth = synthesizer_new(cfg->arena, cfg->num_voices, NUMSNAPSHOTGRAIN, cfg->max_grain_size);
+    if (!g->synth) goto fail;
+
+    g->clock = 0;
 
     return g;
+
+fail:
+    // the delay line may be mapped outside of the arena
+    circbuf_free(g->buffer);
+    return NULL;
 }
 
 
 void granular_free(granular *g) {
-    synthesizer_free(g->synth);
-    evelopbuf_free(g->evelopes);
-    graintable_free(g->grains);
+    // everything else belongs to the arena
     circbuf_free(g->buffer);
-    circbuf_free(g->pitchbuffer);
-    free(g);
 }
 
 
 void granular_perform(granular *g, scheduler *s, vocaldetector *vd, float *in, float *out, int n) {
     grain* gn;
     evelope* ep;
+    // the source of a grain has to stay in the delay line until it has been read
+    float maxspan = g->buffer->size - 2 * n - CIRCBUF_INTERP_LOOKAHEAD;
 
     // Delayline load input stream
     circbuf_write_block(g->buffer, in, n); //load input stream into circbuf constantly @todo add parameter to stop and continue loading 
+    g->buffer->interp = param(int, s->quality);
 
-    // load pitch buffer
-    for (int i = 0; i < n; i++) {
-        circbuf_write_block(g->pitchbuffer, &vd->frequency, 1);
-    }
+    // the pitch is constant for the whole block
+    pitchtimeline_write(g->pitch, vd->frequency, n);
 
-    // sample new grain and add into graintable
-    if (s->dofetch){
-        float speed = semitonefact(param(float, s->grainpitch));
-        float duration = param(float, s->grainsize) * s->cfg->sample_rate;
-        float delay = param(float, s->graindelay) * s->cfg->sample_rate;
-        float position = emod((int) (g->buffer->writetap.position - duration / speed), g->buffer->size);
+    // sample a new grain at every onset and add into graintable. The parameters are taken at the onset's sample
+    for (int i = 0; i < s->numonsets; i++){
+        int offset = s->onsets[i];
+        float speed = semitonefact(param_at(float, s->grainpitch, offset));
+        float duration = param_at(float, s->grainsize, offset) * s->cfg->sample_rate;
+        float delay = param_at(float, s->graindelay, offset) * s->cfg->sample_rate;
+
+        // short delay lines can not hold long or far delayed grains
+        duration = min(duration, maxspan * speed);
+        if (!param(int, s->streaming)) duration = min(duration, g->synth->maxgrainsize);
+        delay = min(delay, maxspan - duration / speed);
+
+        // the write tap is already at the end of the block, go back to the onset
+        float position = emod((int) (g->buffer->writetap.position - (n - offset) - duration / speed), g->buffer->size);
 
         graintable_add_grain(g->grains,
             g->buffer,
-            g->pitchbuffer,
+            g->pitch,
             position,
             duration,
             delay,
             speed,
-            param(int, s->eveloptype));
+            param(int, s->eveloptype),
+            g->clock + offset);
     }
     // post("graintable length: %d",graintable_get_len(g->grains));
 
-    // update state of all grains
-    graintable_update_lifetime(g->grains, n);
+    // fetch every grain whose delay elapses inside this block to synthesize output, earliest first.
+    // The number of grains per block is bounded, grains beyond that start at the beginning of the next block
+    for (int released = 0; released < MAXGRAINRELEASE && (gn = graintable_peek_grain(g->grains)) != NULL; released++){
+        float start = ceilf(grain_get_start(gn, g->clock));
+        if (start >= n) break;
 
-    // fetch grain to synthesize output
-    gn = graintable_peek_grain(g->grains);
-    if (gn && gn->lifetime > gn->delay){ // only relevant when grain delay is implemented
         graintable_pop_grain(g->grains);
 
         // Envelope 
@@ -84,8 +96,14 @@ void granular_perform(granular *g, scheduler *s, vocaldetector *vd, float *in, f
         synthesizer_active_grain(g->synth,
             gn,
             ep,
-            param(int, s->relativepitch));
+            param(int, s->relativepitch),
+            param(int, s->streaming),
+            (int) start,
+            n);
     }
 
     synthesizer_write_output(g->synth, out, n);
+
+    // waiting grains compare their due time against the clock, they do not need to be updated
+    g->clock += n;
 }
@@ -16,24 +16,17 @@ low_frequency_oscillator *lfo_new(goat_config *cfg, const char *name) {
     lfo->phase = 0.0f;
 
     snprintf(namebuf, sizeof(namebuf), "%s.frequency", name);
-    lfo->frequency = control_manager_parameter_add(cfg->mgr,
+    lfo->frequency = control_manager_modulator_parameter_add(cfg->mgr, &lfo->super,
         namebuf, 1.0f, 0.01f, 50.0f);
     
     snprintf(namebuf, sizeof(namebuf), "%s.curve", name);
-    lfo->curve = control_manager_parameter_add(cfg->mgr,
+    lfo->curve = control_manager_modulator_parameter_add(cfg->mgr, &lfo->super,
         namebuf, LFO_CURVE_SINE, 0, LFO_NUM_CURVES - 1);
+    if (lfo->curve) control_parameter_discrete(lfo->curve, 1);
 
     return lfo;
 }
 
-void lfo_free(low_frequency_oscillator *lfo) {
-    control_manager_parameter_remove(lfo->cfg->mgr, lfo->frequency);
-    control_manager_parameter_remove(lfo->cfg->mgr, lfo->curve);
-
-    // removing the modulator from the manager will automatically free the lfo subclass
-    control_manager_modulator_remove(lfo->cfg->mgr, &lfo->super);
-}
-
 void lfo_perform(low_frequency_oscillator *lfo, __attribute__((unused)) float *in, int n) {
     float p = lfo->phase;
     float v;
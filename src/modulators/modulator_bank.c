@@ -3,7 +3,7 @@
 
 
 modulator_bank *modulator_bank_new(goat_config *cfg, vocaldetector *vd) {
-    modulator_bank *modbank = malloc(sizeof(modulator_bank));
+    modulator_bank *modbank = mem_arena_alloc(cfg->arena, sizeof(modulator_bank));
     if (modbank == NULL) return NULL;
     char namebuf[50];
 
@@ -25,17 +25,3 @@ modulator_bank *modulator_bank_new(goat_config *cfg, vocaldetector *vd) {
 
     return modbank;
 }
-
-void modulator_bank_free(modulator_bank *modbank) {
-    for (int i = 0; i < MODBANK_NUM_LFOS; i++) {
-        lfo_free(modbank->lfos[i]);
-    }
-
-    for (int i = 0; i < MODBANK_NUM_RANDS; i++) {
-        rand_mod_free(modbank->rms[i]);
-    }
-
-    vdmod_free(modbank->vodec);
-
-    free(modbank);
-}
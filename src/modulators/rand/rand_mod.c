@@ -2,10 +2,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <math.h>
 #include <time.h>
 #include "util/util.h"
-#include "m_pd.h"
 
 //
 rand_mod *rand_mod_new(goat_config *cfg, const char *name){
@@ -13,42 +13,51 @@ rand_mod *rand_mod_new(goat_config *cfg, const char *name){
         name,
         (control_modulator_perform_method) rand_mod_perform,
         sizeof(rand_mod));
+    if (rm == NULL) return NULL;
     
     rm->cfg = cfg;
-    rm->seed=time(NULL);
     rm->time=0.0f;
 
     char namebuf[32];
 
     snprintf(namebuf, sizeof(namebuf), "%s.frequency", name);
-    rm->freq = control_manager_parameter_add(cfg->mgr,
+    rm->freq = control_manager_modulator_parameter_add(cfg->mgr, &rm->super,
         namebuf, 1.0f, 0.01f, 689.0f );
 
     snprintf(namebuf, sizeof(namebuf), "%s.value", name);
-    rm->mu = control_manager_parameter_add(cfg->mgr,
+    rm->mu = control_manager_modulator_parameter_add(cfg->mgr, &rm->super,
         namebuf, 0.0f, -10.0f, 10.0f);
 
     snprintf(namebuf, sizeof(namebuf), "%s.variation", name);
-    rm->sigma = control_manager_parameter_add(cfg->mgr,
+    rm->sigma = control_manager_modulator_parameter_add(cfg->mgr, &rm->super,
         namebuf, 1.0f, 0.1f, 10.0f);
 
-    return rm;
-}
+    snprintf(namebuf, sizeof(namebuf), "%s.seed", name);
+    rm->seed = control_manager_modulator_parameter_add(cfg->mgr, &rm->super,
+        namebuf, 0.0f, 0.0f, 16777216.0f);
 
+    if (!rm->freq || !rm->mu || !rm->sigma || !rm->seed) return NULL;
+    control_parameter_discrete(rm->seed, 1);
 
-void rand_mod_free(rand_mod *rm){
-    control_manager_parameter_remove(rm->cfg->mgr, rm->freq);
-    control_manager_parameter_remove(rm->cfg->mgr, rm->mu);
-    control_manager_parameter_remove(rm->cfg->mgr, rm->sigma);
+    rand_mod_seed(rm, 0);
 
-    control_manager_modulator_remove(rm->cfg->mgr, &rm->super);
-};
+    return rm;
+}
 
 void rand_mod_perform(rand_mod *rm, __attribute__((unused)) float *in, int n){
     float a = fmod(rm->time, 1/control_parameter_get_float(rm->freq)); //!< Modulus of elapsed time and period of random numbers
     float b = (float) n / (float) rm->cfg->sample_rate; //!< Blocksize/Samplerate=time intervall between blocks
+    // the seed is read from its offset, so that a new seed applies to this block already and is never modulated
+    int seed = (int) roundf(rm->seed->offset);
+
+    // restart the sequence whenever a new seed is set
+    if (seed != rm->appliedseed) {
+        rand_mod_seed(rm, seed);
+        rm->time = 0.0f;
+        a = 0.0f;
+    }
+
     if ( a < b ){
-        rand_setSeed(rm);
         rm->rand_num = rand_nn(rm); //!< perform algorithm
         rm->super.value = rm->rand_num;
         //post("[rand] success: %f",rm->rand_num);//debugging post
@@ -61,43 +70,20 @@ void rand_mod_perform(rand_mod *rm, __attribute__((unused)) float *in, int n){
 }
 
 
-void rand_setSeed(rand_mod *rm){
-    srand(rm->seed);
-    rm->seed=rand();
-}
+void rand_mod_seed(rand_mod *rm, int seed){
+    uint64_t mix = 14695981039346656037ull;
 
+    // FNV-1a of the name, so that modulators with the same seed differ
+    for (const char *c = rm->super.name; *c; c++) mix = (mix ^ (unsigned char) *c) * 1099511628211ull;
 
-float rand_nn(rand_mod *rm) {
+    if (seed == 0) mix ^= ((uint64_t) time(NULL) << 32) ^ (uint64_t) (uintptr_t) rm;
+    else mix ^= (uint64_t) seed;
 
-    float s, t, a, b; //Paramteres defining the distribution
-    s = 0.449871;
-    t = -0.386595;
-    a = 0.196;
-    b = 0.25472;
-    
-    float u, v, w, y, Q; //helper variables for the algorithm
-    int num_rej=0; //limits the loop.
-    
-    while (num_rej <= 10) {
-        u = (float)rand()/RAND_MAX;
-        v = 1.7156*((float)rand()/RAND_MAX-0.5);
-        w = u - s;
-        y = fabs(v) - t;
-        Q = w*w + y*(a*y-b*w);
-        if (Q < 0.27597) {
-            return (v/u*0.5*control_parameter_get_float(rm->sigma)+control_parameter_get_float(rm->mu));
-        }
-        if (Q>0.27846) {
-            num_rej++;
-            continue;
-        }
-        if (v*v > -4*u*u*log(u)) {
-            num_rej++;
-            continue;
-        }
-        else return (v/u*0.5*control_parameter_get_float(rm->sigma)+control_parameter_get_float(rm->mu));
-    }
-return 666; //should never be reached :O
+    rng_seed(&rm->gen, mix);
+    rm->appliedseed = seed;
 }
 
 
+float rand_nn(rand_mod *rm) {
+    return rng_normal(&rm->gen) * 0.5f * control_parameter_get_float(rm->sigma) + control_parameter_get_float(rm->mu);
+}
@@ -14,19 +14,12 @@ vocaldetector_mod *vdmod_new(goat_config *cfg, vocaldetector *vd, const char *na
     vdmod->vd = vd;
 
     snprintf(namebuf, sizeof(namebuf), "%s.factor", name);
-    vdmod->factor = control_manager_parameter_add(cfg->mgr,
+    vdmod->factor = control_manager_modulator_parameter_add(cfg->mgr, &vdmod->super,
         namebuf, 0.001f, -1.0f, 1.0f);
 
     return vdmod;
 }
 
-void vdmod_free(vocaldetector_mod *vdmod) {
-    control_manager_parameter_remove(vdmod->cfg->mgr, vdmod->factor);
-
-    // removing the modulator from the manager will automatically free the vd_mod subclass
-    control_manager_modulator_remove(vdmod->cfg->mgr, &vdmod->super);
-}
-
 void vdmod_perform(vocaldetector_mod *vdmod, __attribute__((unused)) float *in, __attribute__((unused)) int n) {
     vdmod->super.value = vdmod->vd->frequency * param(float, vdmod->factor);
 }
@@ -0,0 +1,77 @@
+#include "pitch/pitchtimeline.h"
+
+#include <stdio.h>
+#include "util/mem.h"
+#include "util/util.h"
+
+
+pitchtimeline *pitchtimeline_new(mem_arena *arena, size_t length, size_t hop) {
+    if (!is_pwrtwo(length) || !is_pwrtwo(hop) || hop > length) {
+        fprintf(stderr, "pitchtimeline_new: length and hop must be powers of two (%" PRI_SIZE_T ", %" PRI_SIZE_T ")\n",
+            length, hop);
+        return NULL;
+    }
+
+    pitchtimeline *pt = mem_arena_alloc(arena, sizeof(pitchtimeline));
+    if (!pt) return NULL;
+
+    pt->size = length / hop;
+
+    // the sums start out zeroed
+    pt->pitchsum = mem_arena_alloc(arena, sizeof(double) * pt->size);
+    if (!pt->pitchsum) return NULL;
+
+    pt->voicedsum = mem_arena_alloc(arena, sizeof(double) * pt->size);
+    if (!pt->voicedsum) return NULL;
+
+    pt->hop = hop;
+    pt->length = length;
+    pt->position = 0;
+    pt->pitchtotal = 0.0;
+    pt->voicedtotal = 0.0;
+
+    return pt;
+}
+
+void pitchtimeline_write(pitchtimeline *pt, float frequency, size_t n) {
+    size_t m, entry;
+
+    while (n > 0) {
+        // fill up the current hop
+        m = min(n, pt->hop - (pt->position & (pt->hop - 1)));
+
+        if (frequency > 0.0f) {
+            pt->pitchtotal += (double) frequency * m;
+            pt->voicedtotal += m;
+        }
+
+        // the entry of the current hop always holds the totals written so far
+        entry = pt->position / pt->hop;
+        pt->pitchsum[entry] = pt->pitchtotal;
+        pt->voicedsum[entry] = pt->voicedtotal;
+
+        pt->position = (pt->position + m) & (pt->length - 1);
+        n -= m;
+    }
+}
+
+float pitchtimeline_mean(pitchtimeline *pt, size_t start, size_t n) {
+    size_t mask = pt->size - 1;
+    size_t first, last, current, before;
+    double voiced;
+
+    if (n == 0) return 0.0f;
+
+    first = (start & (pt->length - 1)) / pt->hop;
+    last = ((start + n - 1) & (pt->length - 1)) / pt->hop;
+    current = ((pt->position - 1) & (pt->length - 1)) / pt->hop;
+
+    // do not read into hops that have not been written yet
+    if (((last - first) & mask) > ((current - first) & mask)) last = current;
+
+    before = (first - 1) & mask;
+    voiced = pt->voicedsum[last] - pt->voicedsum[before];
+    if (voiced < 0.5) return 0.0f;
+
+    return (pt->pitchsum[last] - pt->pitchsum[before]) / voiced;
+}
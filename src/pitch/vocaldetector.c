@@ -5,20 +5,21 @@
 #include "math.h"
 
 
-vocaldetector *vd_new(size_t sample_rate) {
+vocaldetector *vd_new(mem_arena *arena, size_t sample_rate) {
+#ifdef DEBUG
     printf("vocaldetector: buffersize = %" PRI_SIZE_T ", period_min = %" PRI_SIZE_T ", period_max = %" PRI_SIZE_T "\n",
         VD_BUFFER_SIZE, VD_PERIOD_MIN, VD_PERIOD_MAX);
+#endif
 
-    vocaldetector *vd = malloc(sizeof(vocaldetector));
+    vocaldetector *vd = mem_arena_alloc(arena, sizeof(vocaldetector));
     if (!vd) return NULL;
 
-    vd->buffer = malloc(sizeof(float) * VD_BUFFER_SIZE);
+    // the buffer and the bitstream start out zeroed
+    vd->buffer = mem_arena_alloc(arena, sizeof(float) * VD_BUFFER_SIZE);
     if (!vd->buffer) return NULL;
-    for (size_t i = 0; i < VD_BUFFER_SIZE; i++) vd->buffer[i] = 0.0f;
 
-    vd->bitstream = malloc(sizeof(vd_block) * VD_BLOCK_SIZE);
+    vd->bitstream = mem_arena_alloc(arena, sizeof(vd_block) * VD_BLOCK_SIZE);
     if (!vd->bitstream) return NULL;
-    for (size_t i = 0; i < VD_BLOCK_SIZE; i++) vd->bitstream[i] = 0;
 
     vd->sample_rate = sample_rate;
 
@@ -32,11 +33,6 @@ vocaldetector *vd_new(size_t sample_rate) {
     return vd;
 }
 
-void vd_free(vocaldetector *vd) {
-    free(vd->buffer);
-    free(vd);
-}
-
 int is_valid_block_size(size_t n) {
     return is_pwrtwo(n) && n >= VD_BITS_PER_BLOCK && n < VD_BUFFER_SIZE;
 }
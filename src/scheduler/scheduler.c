@@ -5,7 +5,8 @@
 #include "util/util.h"
 
 scheduler *scheduler_new(goat_config *cfg) {
-    scheduler *sd = malloc(sizeof(scheduler));
+    scheduler *sd = mem_arena_alloc(cfg->arena, sizeof(scheduler));
+    control_parameter *grainenv;
     if (!sd) return NULL;
 
 	sd->cfg = cfg;
@@ -15,32 +16,37 @@ scheduler *scheduler_new(goat_config *cfg) {
     sd->graindist = control_manager_parameter_add(cfg->mgr, "graindist", -0.75f, -1.0f, 1.0f);
 	sd->graindelay = control_manager_parameter_add(cfg->mgr, "graindelay", 0.0f, 0.0f, 10.0f);
 	sd->grainpitch = control_manager_parameter_add(cfg->mgr, "grainpitch", 0.0f, -36.0f, 36.0f);
-    sd->eveloptype = control_manager_parameter_add(cfg->mgr, "grainenv", 2, 0, 3);
+    // "grainenv" is kept for the patch and the presets, the grains read "envelope"
+    grainenv = control_manager_parameter_add(cfg->mgr, "grainenv", 2, 0, 3);
     sd->eveloptype = control_manager_parameter_add(cfg->mgr, "envelope", 2, 0, 3);
 	sd->attacktime = control_manager_parameter_add(cfg->mgr, "attacktime",0.12, 0, 0.4);
 	sd->releasetime = control_manager_parameter_add(cfg->mgr, "releasetime",0.12, 0, 0.4);
 	sd->relativepitch = control_manager_parameter_add(cfg->mgr, "relativepitch", 0, 0, 1);
-    sd->lastfetch = 0;
-	sd->dofetch = 0;
+	sd->streaming = control_manager_parameter_add(cfg->mgr, "streaming", 1, 0, 1);
+	sd->quality = control_manager_parameter_add(cfg->mgr, "quality", CIRCBUF_INTERP_LINEAR, CIRCBUF_INTERP_NONE, CIRCBUF_INTERP_SINC);
+	sd->nextonset = 0.0f;
+	sd->numonsets = 0;
+
+	if (!sd->grainsize || !sd->graindist || !sd->graindelay || !sd->grainpitch) return NULL;
+	if (!grainenv || !sd->eveloptype || !sd->relativepitch || !sd->streaming || !sd->quality) return NULL;
+
+	// these select an option, a morph switches them instead of fading
+	control_parameter_discrete(grainenv, 1);
+	control_parameter_discrete(sd->eveloptype, 1);
+	control_parameter_discrete(sd->relativepitch, 1);
+	control_parameter_discrete(sd->streaming, 1);
+	control_parameter_discrete(sd->quality, 1);
+
+	// the grains read these at their onset inside the block
+	if (!control_manager_parameter_audiorate(cfg->mgr, sd->grainsize, cfg->block_size)) return NULL;
+	if (!control_manager_parameter_audiorate(cfg->mgr, sd->graindist, cfg->block_size)) return NULL;
+	if (!control_manager_parameter_audiorate(cfg->mgr, sd->graindelay, cfg->block_size)) return NULL;
+	if (!control_manager_parameter_audiorate(cfg->mgr, sd->grainpitch, cfg->block_size)) return NULL;
 
     return sd;
 }
 
 
-void scheduler_free(scheduler *sd){
-	control_manager_parameter_remove(sd->cfg->mgr, sd->grainsize);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->graindist);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->graindelay);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->grainpitch);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->eveloptype);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->attacktime);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->releasetime);
-	control_manager_parameter_remove(sd->cfg->mgr, sd->relativepitch);
-
-	free(sd);
-}
-
-
 /* void scheduler_update_counter(scheduler *sd, int n){
 
 	if (sd->fetchgrain != 0){
@@ -63,20 +69,28 @@ void scheduler_free(scheduler *sd){
 } */
 
 
+/**
+ * @brief the distance in samples from the grain at sample @a i of the block to the next one. At most one grain per sample
+ */
+static float scheduler_interonset(scheduler *sd, int i) {
+	float actualduration = param_at(float, sd->grainsize, i) * sd->cfg->sample_rate * semitonefact(param_at(float, sd->grainpitch, i));
+	return max(actualduration * (1.0f + param_at(float, sd->graindist, i)), 1.0f);
+}
+
 void scheduler_perform(scheduler *sd, int n){
-	// calculate the distance in samples between two grains.
-	float actualduration = param(float, sd->grainsize) * sd->cfg->sample_rate * semitonefact(param(float, sd->grainpitch));
-	size_t nextfetch = actualduration * (1.0f + param(float, sd->graindist));
-
-	// if enough time elapsed, mark the grain as ready to be fetched and reset the lastfetch counter
-	if (sd->lastfetch > nextfetch) {
-		sd->dofetch = 1;
-		sd->lastfetch = 0;
-	} else {
-		sd->dofetch = 0;
+	int onset;
+
+	// collect every onset inside this block, each one spaced by the parameters at its own sample
+	sd->numonsets = 0;
+	while (sd->nextonset < n && sd->numonsets < SCHEDULER_MAX_ONSETS) {
+		onset = (int) sd->nextonset;
+		sd->onsets[sd->numonsets++] = onset;
+		sd->nextonset += scheduler_interonset(sd, onset);
 	}
 
-	// update the lastfetch counter
-	sd->lastfetch += n;
+	// skip the onsets that did not fit, instead of piling them up for the next blocks
+	if (sd->nextonset < n) sd->nextonset = n;
+
+	sd->nextonset -= n;
 }
 
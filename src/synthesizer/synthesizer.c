@@ -11,156 +11,369 @@
 #define SYNTH_MAX_SPEED 1000.0f
 
 
-activategrain *activategrain_new(grain* gn, evelope* ep, int repeat, int relativepitch){
-    float pitch, pitch_median, pitch_sum;
-    float speed;
+/**
+ * @brief number of output samples a grain can be streamed before the write tap reaches its read position
+ *
+ * @param dist distance between the grain's first sample and the write tap
+ * @param speed read speed of the grain
+ * @param size size of the delay line
+ * @param length number of samples the grain should be played
+ * @param offset number of samples the grain starts after the beginning of the current block
+ * @param n number of samples per block. The write tap moves a whole block ahead of the read position
+ *
+ * The interpolation kernels access up to @ref CIRCBUF_INTERP_LOOKAHEAD samples around the read position,
+ * these must stay clear of the write tap as well.
+ * @return size_t the number of samples that can safely be streamed. At most @a length
+ */
+static size_t synthesizer_stream_timeout(size_t dist, float speed, size_t size, size_t length, int offset, int n){
+    float d = dist == 0 ? (float) size : (float) dist;
+    float timeout = length;
+
+    // the read position must stay behind the newest sample, even when a new block was written
+    // and the write tap must not reach the first sample before the grain has started
+    if (d < n + CIRCBUF_INTERP_LOOKAHEAD || d + offset + CIRCBUF_INTERP_LOOKAHEAD > size) return 0;
+
+    if (speed > 1.0f) {
+        // the read position catches up with the write tap
+        timeout = min(timeout, (d - n - CIRCBUF_INTERP_LOOKAHEAD) / (speed - 1.0f));
+    } else if (speed < 1.0f) {
+        // the write tap overtakes the read position and overwrites the grain
+        timeout = min(timeout, (size - d - offset - CIRCBUF_INTERP_LOOKAHEAD) / (1.0f - speed));
+    }
+
+    return (size_t) timeout;
+}
+
+
+/**
+ * @brief mix a block of samples onto the output
+ *
+ * Both buffers are marked as not aliasing and the loop has no branches,
+ * so that the compiler can emit SSE/AVX/NEON code for it.
+ */
+static inline void synthesizer_mix(float *restrict dst, const float *restrict src, int n){
+    for (int i = 0; i < n; i++) dst[i] += src[i];
+}
+
+
+synthesizer *synthesizer_new(mem_arena *arena, int length, int numsnapshots, size_t maxgrainsize){
+    int numwords = (length + 63) / 64;
+
+    synthesizer *syn = mem_arena_alloc(arena, sizeof(synthesizer));
+    if (!syn) return NULL;
+
+    // every voice field gets its own contiguous array
+    syn->position = mem_arena_alloc(arena, sizeof(double) * length);
+    if (!syn->position) return NULL;
+
+    syn->speed = mem_arena_alloc(arena, sizeof(float) * length);
+    if (!syn->speed) return NULL;
+
+    syn->envpos = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->envpos) return NULL;
+
+    syn->remaining = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->remaining) return NULL;
+
+    syn->offset = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->offset) return NULL;
+
+    syn->snapshot = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->snapshot) return NULL;
+
+    syn->env = mem_arena_alloc(arena, sizeof(evelope) * length);
+    if (!syn->env) return NULL;
+
+    syn->copied = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->copied) return NULL;
+
+    syn->copypos = mem_arena_alloc(arena, sizeof(double) * length);
+    if (!syn->copypos) return NULL;
+
+    syn->deadline = mem_arena_alloc(arena, sizeof(float) * length);
+    if (!syn->deadline) return NULL;
+
+    // no voice is live yet
+    syn->live = mem_arena_alloc(arena, sizeof(uint64_t) * numwords);
+    if (!syn->live) return NULL;
+
+    syn->repeat = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->repeat) return NULL;
+
+    syn->origin = mem_arena_alloc(arena, sizeof(grain) * length);
+    if (!syn->origin) return NULL;
 
-    activategrain *ag = malloc(sizeof(activategrain));
-    if (!ag) return NULL;
+    syn->freelist = mem_arena_alloc(arena, sizeof(int) * length);
+    if (!syn->freelist) return NULL;
 
-    memcpy(&ag->origin, gn, sizeof(grain));
+    // copied grains need their own storage, which is only available for a few voices.
+    // Its pages are only backed by memory once a grain has been copied into them
+    syn->snapshotdata = mem_arena_alloc(arena, sizeof(float) * maxgrainsize * numsnapshots);
+    if (!syn->snapshotdata) return NULL;
 
-    ag->data = malloc(sizeof(float) * gn->gb_size); // to store grain samples
-    if (!ag->data) return NULL;
+    syn->snapshotfree = mem_arena_alloc(arena, sizeof(int) * numsnapshots);
+    if (!syn->snapshotfree) return NULL;
+
+    // push the voices in reverse order, so that the lowest voices are used first
+    for (int i = 0; i < length; i++){
+        syn->snapshot[i] = -1;
+        syn->freelist[i] = length - 1 - i;
+    }
+
+    for (int i = 0; i < numsnapshots; i++){
+        syn->snapshotfree[i] = numsnapshots - 1 - i;
+    }
+
+    syn->length = length;
+    syn->numlive = 0;
+    syn->numfree = length;
+    syn->source = NULL;
+
+    syn->maxgrainsize = maxgrainsize;
+    syn->numsnapshots = numsnapshots;
+    syn->numsnapshotsfree = numsnapshots;
+
+    syn->numacquired = 0;
+    syn->numreleased = 0;
+    syn->numdropped = 0;
+
+    return syn;
+}
+
+
+int synthesizer_acquire_voice(synthesizer *syn){
+    if (syn->numfree == 0) return -1;
+
+    syn->numacquired++;
+    return syn->freelist[--syn->numfree];
+}
+
+
+void synthesizer_release_voice(synthesizer *syn, int v){
+    if (SYNTH_IS_LIVE(syn, v)) {
+        syn->live[v / 64] &= ~((uint64_t) 1 << (v % 64));
+        syn->numlive--;
+    }
+
+    if (syn->snapshot[v] >= 0) {
+        syn->snapshotfree[syn->numsnapshotsfree++] = syn->snapshot[v];
+        syn->snapshot[v] = -1;
+    }
+
+    syn->numreleased++;
+    syn->freelist[syn->numfree++] = v;
+}
+
+
+int synthesizer_voice_init(synthesizer *syn, int v, grain* gn, evelope* ep, int repeat, int relativepitch, int streaming, int offset, int n){
+    float pitch;
+    float speed;
+    size_t dist;
+    grain *origin = &syn->origin[v];
+
+    memcpy(origin, gn, sizeof(grain));
 
     int bufstart = emod((int) (gn->position - gn->delay), gn->cb->size);
 
     // determine the speed of the grain
     if (relativepitch) {
-        // get the median pitch
-        gn->pb->readtaps->position = bufstart;
-
-        pitch_median = 0.0f;
-        pitch_sum = 0.0f;
-        for (size_t i = 0; i < gn->gb_size; i++) {
-            pitch = circbuf_read_interp(gn->pb, 0);
-            if (pitch == -1) continue; // ignore unvoiced samples
-
-            pitch_median += pitch;
-            pitch_sum++;
-        }
+        // get the mean of the voiced pitch
+        pitch = pitchtimeline_mean(gn->pt, bufstart, gn->gb_size);
 
-        if (pitch_sum == 0) {
+        if (pitch <= 0.0f) {
             // no pitch information available
             speed = 1.0f;
         } else {
-            pitch_median /= pitch_sum;
-            speed = 220.0f / pitch_median * gn->speed;
+            speed = 220.0f / pitch * gn->speed;
         }
     } else {
         speed = gn->speed;
     }
 
-    // read the data block with the specific speed
-    gn->cb->readtaps->position = bufstart;
-    gn->cb->readtaps->speed = speed;
-    circbuf_read_block(gn->cb, 0, ag->data, gn->gb_size);
+    // keep the interpolation kernels inside a sane range of positions
+    speed = min(max(speed, SYNTH_MIN_SPEED), SYNTH_MAX_SPEED);
+
+    // stream the grain if the write tap will not reach it while it is playing
+    dist = CIRCBUF_DIST((size_t) bufstart, gn->cb->writetap.position, gn->cb->size);
+    origin->timeout = synthesizer_stream_timeout(
+        dist,
+        speed,
+        gn->cb->size,
+        gn->gb_size,
+        offset,
+        n);
+
+    if (streaming && origin->timeout >= gn->gb_size) {
+        syn->position[v] = bufstart;
+        syn->envpos[v] = 0;
+    } else {
+        if (gn->gb_size > syn->maxgrainsize || syn->numsnapshotsfree == 0) return 0;
+
+        // the snapshot is filled while the voice plays, see synthesizer_voice_copy
+        syn->snapshot[v] = syn->snapshotfree[--syn->numsnapshotsfree];
+        syn->copied[v] = 0;
+        syn->copypos[v] = bufstart;
+        syn->deadline[v] = dist == 0 ? gn->cb->size : gn->cb->size - dist;
 
-    // apply the grain envelope
-    for (size_t i = 0; i < gn->gb_size; i++) {
-        ag->data[i] *= ep->data[i];
+        syn->position[v] = 0.0;
     }
 
-    ag->pos = 0;
-    ag->length = gn->gb_size;
-    ag->repeat = repeat;
+    syn->source = gn->cb;
+    syn->speed[v] = speed;
+    memcpy(&syn->env[v], ep, sizeof(evelope));
 
-    return ag;
-}
+    syn->remaining[v] = gn->gb_size;
+    syn->offset[v] = offset;
+    syn->repeat[v] = repeat;
 
+    syn->live[v / 64] |= (uint64_t) 1 << (v % 64);
+    syn->numlive++;
 
-void activategrain_free(activategrain *ag){
-    if (!ag) {
-        // post("grain already freed!");
-        return; 
-    }
-    free(ag->data);
-    free(ag);
-    // post("activategrain freed!");
+    return 1;
 }
 
 
-synthesizer *synthesizer_new(int length){
-    synthesizer *syn = malloc(sizeof(synthesizer));
-    if (!syn) return NULL;
+int synthesizer_voice_copy(synthesizer *syn, int v, int n, int *budget){
+    int length = syn->origin[v].gb_size;
+    int target, written, m;
+    float *data;
 
-    syn->data = malloc(sizeof(p_activategrain) * length);
-    if (!syn->data) return NULL;
+    if (syn->snapshot[v] < 0 || syn->copied[v] >= length) return 0;
 
-    for (int i = 0; i < length; i++){
-        syn->data[i] = NULL;
+    // the samples the playhead reads in this block
+    target = (int) syn->position[v] + max(n - syn->offset[v], 0);
+
+    // the samples the write tap overwrites in the next block, including the reach of the interpolation
+    target = max(target, (int) ceilf((n + CIRCBUF_INTERP_LOOKAHEAD - syn->deadline[v]) / syn->speed[v]));
+
+    // the samples of the grain the write tap has already written, reading ahead must not pass them
+    written = (int) floorf((syn->source->size - syn->deadline[v] - CIRCBUF_INTERP_LOOKAHEAD) / syn->speed[v]);
+    syn->deadline[v] -= n;
+
+    target = min(target, length);
+
+    // read ahead with the spare budget
+    m = min(*budget, min(written, length) - max(target, syn->copied[v]));
+    if (m > 0) {
+        target = max(target, syn->copied[v]) + m;
+        *budget -= m;
     }
-    syn->length = length;
 
-    return syn;
+    m = target - syn->copied[v];
+    if (m <= 0) return 0;
+
+    data = &syn->snapshotdata[syn->snapshot[v] * syn->maxgrainsize + syn->copied[v]];
+
+    // read the data block with the specific speed and apply the grain envelope
+    syn->copypos[v] = circbuf_read_span(syn->source, syn->copypos[v], syn->speed[v], data, m);
+    evelope_apply(&syn->env[v], syn->copied[v], data, m);
+
+    syn->copied[v] += m;
+
+    return m;
 }
 
 
-void synthesizer_free(synthesizer *syn){
-    for (int i = 0; i < syn->length; i++){
-        activategrain_free(syn->data[i]);
+int synthesizer_voice_render(synthesizer *syn, int v, float *out, int n){
+    float *data;
+    int m;
+
+    // wait for the grain's onset inside the block
+    if (syn->offset[v] > 0) {
+        m = min(syn->offset[v], n);
+        syn->offset[v] -= m;
+        out += m;
+        n -= m;
+        if (n == 0) return 1;
     }
-    free(syn->data);
-    free(syn);
-    // post("synthesizer freed!");
-}
 
+    if (syn->snapshot[v] < 0) {
+        // streamed voice: read from the delay line and apply the envelope on the fly
+        while (n > 0 && syn->remaining[v] > 0) {
+            m = min(min(n, SYNTH_SCRATCH_SIZE), syn->remaining[v]);
 
-void synthesizer_active_grain(synthesizer *syn, grain* gn, evelope* ep, int relativepitch){
-    activategrain *ag = activategrain_new(gn, ep, 0, relativepitch); // set repeat to 0
-    if (!ag) return;
+            syn->position[v] = circbuf_read_span(syn->source, syn->position[v], syn->speed[v], syn->scratch, m);
+            evelope_apply(&syn->env[v], syn->envpos[v], syn->scratch, m);
+            synthesizer_mix(out, syn->scratch, m);
 
-    for (int i = 0; i < syn->length; i++){
-        if (syn->data[i] == NULL){
-            syn->data[i] = ag;
-            return;
+            syn->envpos[v] += m;
+            syn->remaining[v] -= m;
+            out += m;
+            n -= m;
         }
+
+        return syn->remaining[v] > 0;
     }
-    // post("synthesizer_active_grain: no more space for another activated grain, discard");
-}
 
+    // copied voice: mix a contiguous span of the snapshot
+    data = &syn->snapshotdata[syn->snapshot[v] * syn->maxgrainsize];
+    while (n > 0) {
+        m = min(n, syn->remaining[v]);
+        synthesizer_mix(out, &data[(int) syn->position[v]], m);
 
-void synthesizer_freeze_grains(synthesizer *syn, int repeat){
-    activategrain *ag = NULL;
-    for (int i = 0; i < syn->length; i++){
-        if (syn->data[i] != NULL){
-            ag = syn->data[i];
-            ag->repeat = repeat;
+        syn->position[v] += m;
+        syn->remaining[v] -= m;
+        out += m;
+        n -= m;
+
+        if (syn->remaining[v] == 0) {
+            if (syn->repeat[v] == 0) return 0;
+
+            syn->position[v] = 0.0;
+            syn->remaining[v] = syn->origin[v].gb_size;
         }
     }
+
+    return 1;
 }
 
 
-float synthesizer_sum_samples(synthesizer *syn){
-    float tmp = 0.0;
-    activategrain *ag = NULL;
-    for (int i = 0; i < syn->length; i++){
-        if (syn->data[i] != NULL){
-            ag = syn->data[i];
-            tmp += ag->data[ag->pos];
-            ag->pos++;
-            if (ag->pos >= ag->length && ag->repeat == 0){
-                activategrain_free(ag); 
-                syn->data[i] = NULL;
-            }
-            else if (ag->repeat == 1){
-                ag->pos = 0;
-            }
-        }
+void synthesizer_active_grain(synthesizer *syn, grain* gn, evelope* ep, int relativepitch, int streaming, int offset, int n){
+    int v = synthesizer_acquire_voice(syn);
+
+    if (v < 0) {
+        // no more space for another activated grain, discard
+        syn->numdropped++;
+        return;
     }
 
-    return tmp;
+    if (!synthesizer_voice_init(syn, v, gn, ep, 0, relativepitch, streaming, offset, n)) { // set repeat to 0
+        // the grain can not be streamed and there is no snapshot buffer left
+        synthesizer_release_voice(syn, v);
+        syn->numdropped++;
+    }
 }
 
 
-void synthesizer_write_output(synthesizer *syn, float *out, int n){
-    while (n--) *out++ = synthesizer_sum_samples(syn);
+void synthesizer_freeze_grains(synthesizer *syn, int repeat){
+    for (int v = 0; v < syn->length; v++){
+        if (SYNTH_IS_LIVE(syn, v) && syn->snapshot[v] >= 0){
+            syn->repeat[v] = repeat;
+        }
+    }
 }
 
 
+void synthesizer_write_output(synthesizer *syn, float *out, int n){
+    uint64_t word;
+    int v;
+    int budget = SYNTH_COPY_BUDGET;
 
+    memset(out, 0, sizeof(float) * n);
 
+    // render voice by voice, visiting only the set bits of the live mask
+    for (int w = 0; w < (syn->length + 63) / 64; w++){
+        word = syn->live[w];
 
+        while (word){
+            v = w * 64 + util_ctz(word);
+            word &= word - 1;
 
+            synthesizer_voice_copy(syn, v, n, &budget);
 
-
+            if (!synthesizer_voice_render(syn, v, out, n)){
+                synthesizer_release_voice(syn, v);
+            }
+        }
+    }
+}
@@ -1,24 +1,150 @@
+#define _GNU_SOURCE // for memfd_create
 #include "util/circbuf.h"
 
 #include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
 #include "util/mem.h"
 #include "util/util.h"
 
+#if defined(__linux__) && !defined(CIRCBUF_NO_MIRROR)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
 
-circbuf *circbuf_new(size_t size, size_t num_readtaps) {
+
+// the sinc kernel is the same for every buffer, one extra phase covers rounding the fraction up to 1
+static float circbuf_sinc_table[CIRCBUF_SINC_PHASES + 1][CIRCBUF_SINC_TAPS];
+// instances may be created from several threads at once, the table is filled by the first one
+static pthread_once_t circbuf_sinc_once = PTHREAD_ONCE_INIT;
+
+static void circbuf_sinc_init(void) {
+    double x, h, w, sum;
+
+    for (int p = 0; p <= CIRCBUF_SINC_PHASES; p++) {
+        sum = 0.0;
+
+        for (int j = 0; j < CIRCBUF_SINC_TAPS; j++) {
+            // distance of the tap to the read position, the taps are at -3 ... +4
+            x = j - (CIRCBUF_SINC_TAPS / 2 - 1) - (double) p / CIRCBUF_SINC_PHASES;
+            h = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            w = 0.42 + 0.5 * cos(M_PI * x / (CIRCBUF_SINC_TAPS / 2)) + 0.08 * cos(2.0 * M_PI * x / (CIRCBUF_SINC_TAPS / 2));
+
+            circbuf_sinc_table[p][j] = h * w;
+            sum += h * w;
+        }
+
+        // normalize to unity gain at dc
+        for (int j = 0; j < CIRCBUF_SINC_TAPS; j++) circbuf_sinc_table[p][j] /= sum;
+    }
+}
+
+
+/**
+ * @brief map the same pages twice back to back
+ *
+ * A memfd of @a bytes is mapped into both halves of a reserved region of twice the size,
+ * so that writing to one half changes the other as well.
+ * Buffers made of whole huge pages are aligned to them, so that they can be backed by transparent huge pages.
+ *
+ * @return float* the start of the region or `NULL` if mirroring is not available
+ */
+static void *circbuf_map_mirrored(size_t bytes) {
+#if defined(__linux__) && !defined(CIRCBUF_NO_MIRROR) && defined(MFD_CLOEXEC)
+    long pagesize = sysconf(_SC_PAGESIZE);
+    size_t align = bytes % MEM_HUGEPAGE == 0 ? MEM_HUGEPAGE : 0;
+    char *region, *start;
+    int fd;
+
+    if (pagesize <= 0 || bytes % pagesize != 0) return NULL;
+
+    fd = memfd_create("circbuf", MFD_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    if (ftruncate(fd, bytes) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // reserve the address space first, so that both halves are adjacent
+    region = mmap(NULL, 2 * bytes + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    if (align) {
+        // give back the parts of the reservation before and after the aligned region
+        start = (char *) (((uintptr_t) region + align - 1) & ~((uintptr_t) align - 1));
+        if (start > region) munmap(region, start - region);
+        if (region + align > start) munmap(start + 2 * bytes, region + align - start);
+        region = start;
+    }
+
+    if (mmap(region, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(region + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(region, 2 * bytes);
+        close(fd);
+        return NULL;
+    }
+
+    // the mappings keep the memory alive
+    close(fd);
+
+    return region;
+#else
+    (void) bytes;
+    return NULL;
+#endif
+}
+
+static void circbuf_unmap_mirrored(void *data, size_t bytes) {
+#if defined(__linux__) && !defined(CIRCBUF_NO_MIRROR) && defined(MFD_CLOEXEC)
+    munmap(data, 2 * bytes);
+#else
+    (void) data;
+    (void) bytes;
+#endif
+}
+
+static size_t circbuf_samplesize(circbuf_format format) {
+    switch (format) {
+    case CIRCBUF_FORMAT_INT16:
+    case CIRCBUF_FORMAT_FLOAT16:
+        return sizeof(uint16_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+circbuf *circbuf_new(mem_arena *arena, size_t size, size_t num_readtaps, circbuf_format format) {
     if (!is_pwrtwo(size)) {
         fprintf(stderr, "circbuf_new: size must be a power of two %" PRI_SIZE_T "\n", size);
         return NULL;
     }
 
-    circbuf *cb = malloc(sizeof(circbuf) + sizeof(circbuf_readtap) * num_readtaps);
+    circbuf *cb = mem_arena_alloc(arena, sizeof(circbuf) + sizeof(circbuf_readtap) * num_readtaps);
     if (cb == NULL) return NULL;
 
-    cb->data = malloc(sizeof(float) * size);
-    if (cb->data == NULL) return NULL; 
+    cb->format = format;
+    cb->samplesize = circbuf_samplesize(format);
+
+    // prefer the mirrored layout, fall back to a plain array.
+    // Both start out zeroed, which is silence in every format
+    cb->data = circbuf_map_mirrored(cb->samplesize * size);
+    cb->mirrored = cb->data != NULL;
+
+    if (!cb->mirrored) {
+        cb->data = mem_arena_alloc(arena, cb->samplesize * size);
+        if (cb->data == NULL) return NULL; 
+    }
 
     cb->size = size;
     cb->num_readtaps = num_readtaps;
+    cb->interp = CIRCBUF_INTERP_NONE;
+
+    pthread_once(&circbuf_sinc_once, circbuf_sinc_init);
 
     // initialize the writetap
     cb->writetap.position = 0;
@@ -33,8 +159,74 @@ circbuf *circbuf_new(size_t size, size_t num_readtaps) {
 }
 
 void circbuf_free(circbuf *cb) {
-    free(cb->data);
-    free(cb);
+    if (cb->mirrored) circbuf_unmap_mirrored(cb->data, cb->samplesize * cb->size);
+}
+
+int circbuf_lock(circbuf *cb) {
+    return mem_lock(cb->data, (cb->mirrored ? 2 : 1) * cb->samplesize * cb->size);
+}
+
+
+/**
+ * @brief convert a half precision float to single precision
+ *
+ * Only integer operations are used, so that the compiler can vectorize the conversion.
+ * Subnormal numbers are flushed to zero.
+ */
+static inline float circbuf_half_to_float(uint16_t h) {
+    uint32_t exponent = h & 0x7c00;
+    uint32_t bits = ((uint32_t) (h & 0x8000) << 16)
+        | (exponent ? (exponent + 0x1c000) << 13 | (uint32_t) (h & 0x03ff) << 13 : 0);
+    float f;
+
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+/**
+ * @brief convert a single precision float to half precision, rounding to nearest
+ *
+ * Values that are too large are clipped to the largest half, subnormal results are flushed to zero.
+ */
+static inline uint16_t circbuf_float_to_half(float f) {
+    uint32_t bits, sign, mantissa, h;
+    int32_t exponent;
+
+    memcpy(&bits, &f, sizeof(float));
+    sign = (bits >> 16) & 0x8000;
+    exponent = (int32_t) ((bits >> 23) & 0xff) - 112;
+    mantissa = bits & 0x7fffff;
+
+    if (exponent <= 0) return sign;
+
+    h = ((uint32_t) exponent << 10 | mantissa >> 13) + ((mantissa >> 12) & 1);
+    return sign | min(h, 0x7bffu);
+}
+
+static inline int16_t circbuf_float_to_int16(float f) {
+    f = min(max(f, -1.0f), 1.0f) * 32767.0f;
+    return (int16_t) (f + (f < 0.0f ? -0.5f : 0.5f));
+}
+
+/**
+ * @brief convert and store a contiguous block of samples
+ */
+static void circbuf_store(circbuf *cb, size_t position, const float *restrict src, size_t n) {
+    switch (cb->format) {
+    case CIRCBUF_FORMAT_INT16: {
+        int16_t *restrict dst = (int16_t *) cb->data + position;
+        for (size_t i = 0; i < n; i++) dst[i] = circbuf_float_to_int16(src[i]);
+        break;
+    }
+    case CIRCBUF_FORMAT_FLOAT16: {
+        uint16_t *restrict dst = (uint16_t *) cb->data + position;
+        for (size_t i = 0; i < n; i++) dst[i] = circbuf_float_to_half(src[i]);
+        break;
+    }
+    default:
+        memcpy((float *) cb->data + position, src, sizeof(float) * n);
+        break;
+    }
 }
 
 void circbuf_write_block(circbuf *cb, float *src, size_t n) {
@@ -45,16 +237,16 @@ void circbuf_write_block(circbuf *cb, float *src, size_t n) {
             n, cb->size);
     }
 
-    if (cb->writetap.position + n <= cb->size) {
-        // simple copy
-        memcpy(&cb->data[cb->writetap.position], src, sizeof(float) * n);
+    if (cb->mirrored || cb->writetap.position + n <= cb->size) {
+        // simple copy, the mirror takes care of the part after the end
+        circbuf_store(cb, cb->writetap.position, src, n);
     } else {
         // target destination wraps around: we need to copy in two steps
         na = cb->size - cb->writetap.position;
         nb = cb->writetap.position + n - cb->size;
 
-        memcpy(&cb->data[cb->writetap.position], src, sizeof(float) * na);
-        memcpy(cb->data, src + na, sizeof(float) * nb);
+        circbuf_store(cb, cb->writetap.position, src, na);
+        circbuf_store(cb, 0, src + na, nb);
     }
 
     cb->writetap.position += n;
@@ -67,13 +259,10 @@ float circbuf_read_interp(circbuf *cb, size_t tap) {
             tap, cb->num_readtaps);
     }
 
+    float sample;
     circbuf_readtap *t = &cb->readtaps[tap];
-    float sample = cb->data[(int) t->position];
 
-    t->position += t->speed;
-
-    if (t->position < 0.0f) t->position += cb->size;
-    if (t->position >= cb->size) t->position -= cb->size;
+    t->position = circbuf_read_span(cb, t->position, t->speed, &sample, 1);
 
     return sample;
 }
@@ -84,5 +273,180 @@ void circbuf_read_block(circbuf *cb, size_t tap, float *dst, size_t n) {
             n, cb->size);
     }
 
-    while (n--) *dst++ = circbuf_read_interp(cb, tap);
+    if (tap >= cb->num_readtaps) {
+        fprintf(stderr, "circbuf_read_block: tap index out of bounds (%" PRI_SIZE_T " >= %" PRI_SIZE_T ")\n",
+            tap, cb->num_readtaps);
+        return;
+    }
+
+    cb->readtaps[tap].position = circbuf_read_span(cb, cb->readtaps[tap].position, cb->readtaps[tap].speed, dst, n);
+}
+
+/**
+ * @brief branch-free floor that the compiler can vectorize
+ */
+static inline int circbuf_floor(float x) {
+    int i = (int) x;
+    return i - (x < i);
+}
+
+static void circbuf_hermite_weights(float f, float *w) {
+    w[0] = ((-0.5f * f + 1.0f) * f - 0.5f) * f;
+    w[1] = (1.5f * f - 2.5f) * f * f + 1.0f;
+    w[2] = ((-1.5f * f + 2.0f) * f + 0.5f) * f;
+    w[3] = (0.5f * f - 0.5f) * f * f;
+}
+
+#define CIRCBUF_LOAD_FLOAT(data, i) ((data)[i])
+#define CIRCBUF_LOAD_INT16(data, i) ((data)[i] * (1.0f / 32767.0f))
+#define CIRCBUF_LOAD_FLOAT16(data, i) circbuf_half_to_float((data)[i])
+
+/**
+ * @brief define the interpolation kernels for one storage format
+ *
+ * Every kernel converts the samples as it loads them, so the conversion is part of the same
+ * branch-free loop. The fir kernel convolves contiguous samples with a constant kernel.
+ * Its loops run over the samples for each tap, so that every pass is a plain multiply-add of two arrays.
+ */
+#define CIRCBUF_DEFINE_KERNELS(name, type, LOAD) \
+    static void circbuf_fir_##name(const type *restrict src, const float *restrict w, int taps, float *restrict dst, int n) { \
+        for (int i = 0; i < n; i++) dst[i] = w[0] * LOAD(src, i); \
+        for (int j = 1; j < taps; j++) { \
+            for (int i = 0; i < n; i++) dst[i] += w[j] * LOAD(src, i + j); \
+        } \
+    } \
+    \
+    static void circbuf_kernel_none_##name(const type *data, int mask, int base, float frac, float speed, float *restrict dst, int n) { \
+        for (int i = 0; i < n; i++) { \
+            dst[i] = LOAD(data, (base + circbuf_floor(frac + i * speed)) & mask); \
+        } \
+    } \
+    \
+    static void circbuf_kernel_linear_##name(const type *data, int mask, int base, float frac, float speed, float *restrict dst, int n) { \
+        for (int i = 0; i < n; i++) { \
+            float p = frac + i * speed; \
+            int k = circbuf_floor(p); \
+            float f = p - k; \
+            float a = LOAD(data, (base + k) & mask); \
+            float b = LOAD(data, (base + k + 1) & mask); \
+            dst[i] = a + f * (b - a); \
+        } \
+    } \
+    \
+    static void circbuf_kernel_hermite_##name(const type *data, int mask, int base, float frac, float speed, float *restrict dst, int n) { \
+        for (int i = 0; i < n; i++) { \
+            float p = frac + i * speed; \
+            int k = circbuf_floor(p); \
+            float f = p - k; \
+            float xm1 = LOAD(data, (base + k - 1) & mask); \
+            float x0 = LOAD(data, (base + k) & mask); \
+            float x1 = LOAD(data, (base + k + 1) & mask); \
+            float x2 = LOAD(data, (base + k + 2) & mask); \
+            float c1 = 0.5f * (x1 - xm1); \
+            float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2; \
+            float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1); \
+            dst[i] = ((c3 * f + c2) * f + c1) * f + x0; \
+        } \
+    } \
+    \
+    static void circbuf_kernel_sinc_##name(const type *data, int mask, int base, float frac, float speed, float *restrict dst, int n) { \
+        for (int i = 0; i < n; i++) { \
+            float p = frac + i * speed; \
+            int k = circbuf_floor(p); \
+            const float *h = circbuf_sinc_table[(int) ((p - k) * CIRCBUF_SINC_PHASES + 0.5f)]; \
+            float sum = 0.0f; \
+            for (int j = 0; j < CIRCBUF_SINC_TAPS; j++) { \
+                sum += h[j] * LOAD(data, (base + k + j - (CIRCBUF_SINC_TAPS / 2 - 1)) & mask); \
+            } \
+            dst[i] = sum; \
+        } \
+    } \
+    \
+    static void circbuf_read_##name(circbuf *cb, const type *data, int base, float frac, float speed, int mask, int contiguous, float *dst, int n) { \
+        float w[CIRCBUF_SINC_TAPS]; \
+        if (contiguous) { \
+            /* the fraction is the same for the whole block, the kernel reduces to a fixed filter. */ \
+            /* Integer positions are not interpolated by any of the kernels */ \
+            switch (frac == 0.0f ? CIRCBUF_INTERP_NONE : cb->interp) { \
+            case CIRCBUF_INTERP_LINEAR: \
+                w[0] = 1.0f - frac; \
+                w[1] = frac; \
+                circbuf_fir_##name(&data[base], w, 2, dst, n); \
+                break; \
+            case CIRCBUF_INTERP_HERMITE: \
+                circbuf_hermite_weights(frac, w); \
+                circbuf_fir_##name(&data[base - 1], w, 4, dst, n); \
+                break; \
+            case CIRCBUF_INTERP_SINC: \
+                circbuf_fir_##name(&data[base - (CIRCBUF_SINC_TAPS / 2 - 1)], \
+                    circbuf_sinc_table[(int) (frac * CIRCBUF_SINC_PHASES + 0.5f)], CIRCBUF_SINC_TAPS, dst, n); \
+                break; \
+            default: \
+                w[0] = 1.0f; \
+                circbuf_fir_##name(&data[base], w, 1, dst, n); \
+                break; \
+            } \
+        } else { \
+            switch (cb->interp) { \
+            case CIRCBUF_INTERP_LINEAR: \
+                circbuf_kernel_linear_##name(data, mask, base, frac, speed, dst, n); \
+                break; \
+            case CIRCBUF_INTERP_HERMITE: \
+                circbuf_kernel_hermite_##name(data, mask, base, frac, speed, dst, n); \
+                break; \
+            case CIRCBUF_INTERP_SINC: \
+                circbuf_kernel_sinc_##name(data, mask, base, frac, speed, dst, n); \
+                break; \
+            default: \
+                circbuf_kernel_none_##name(data, mask, base, frac, speed, dst, n); \
+                break; \
+            } \
+        } \
+    }
+
+CIRCBUF_DEFINE_KERNELS(float, float, CIRCBUF_LOAD_FLOAT)
+CIRCBUF_DEFINE_KERNELS(int16, int16_t, CIRCBUF_LOAD_INT16)
+CIRCBUF_DEFINE_KERNELS(float16, uint16_t, CIRCBUF_LOAD_FLOAT16)
+
+double circbuf_read_span(circbuf *cb, double position, float speed, float *dst, size_t n) {
+    int mask = cb->size - 1;
+    int base = (int) floor(position);
+    float frac = position - base;
+    int limit = cb->mirrored ? 2 * (int) cb->size : (int) cb->size;
+    int contiguous;
+
+    base &= mask;
+
+    if (cb->mirrored) {
+        // the samples before the start of the buffer are found at the end of the first copy
+        if (base < CIRCBUF_INTERP_LOOKAHEAD) base += cb->size;
+
+        // a span that ends inside the second copy does not need to wrap its indices
+        if (speed >= 0.0f && base + (double) speed * n + 2 * CIRCBUF_INTERP_LOOKAHEAD <= limit) mask = -1;
+    }
+
+    contiguous = speed == 1.0f
+        && base >= CIRCBUF_INTERP_LOOKAHEAD
+        && base + (int) n + CIRCBUF_INTERP_LOOKAHEAD <= limit;
+
+    switch (cb->format) {
+    case CIRCBUF_FORMAT_INT16:
+        circbuf_read_int16(cb, cb->data, base, frac, speed, mask, contiguous, dst, n);
+        break;
+    case CIRCBUF_FORMAT_FLOAT16:
+        circbuf_read_float16(cb, cb->data, base, frac, speed, mask, contiguous, dst, n);
+        break;
+    default:
+        if (contiguous && (frac == 0.0f || cb->interp == CIRCBUF_INTERP_NONE)) {
+            memcpy(dst, (float *) cb->data + base, sizeof(float) * n);
+        } else {
+            circbuf_read_float(cb, cb->data, base, frac, speed, mask, contiguous, dst, n);
+        }
+        break;
+    }
+
+    position += (double) speed * n;
+    position -= floor(position / cb->size) * cb->size;
+
+    return position;
 }
@@ -0,0 +1,157 @@
+#define MEM_NO_REDEFINE
+#include "util/mem.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include "util/util.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
+    #define MEM_POSIX
+#endif
+
+#if defined(MAP_ANONYMOUS) && !defined(MAXMSPSDK)
+    #define MEM_ARENA_MMAP
+    #ifndef MAP_NORESERVE
+        #define MAP_NORESERVE 0
+    #endif
+#endif
+
+
+#if defined(DEBUG) && !defined(MAXMSPSDK)
+
+size_t mem_heapcalls = 0;
+
+void *mem_counted_malloc(size_t size) {
+    mem_heapcalls++;
+    return malloc(size);
+}
+
+void *mem_counted_calloc(size_t num, size_t size) {
+    mem_heapcalls++;
+    return calloc(num, size);
+}
+
+void *mem_counted_realloc(void *ptr, size_t size) {
+    mem_heapcalls++;
+    return realloc(ptr, size);
+}
+
+void mem_counted_free(void *ptr) {
+    mem_heapcalls++;
+    free(ptr);
+}
+
+#endif
+
+
+#define mem_align(n) (((n) + MEM_CACHELINE - 1) & ~((size_t) MEM_CACHELINE - 1))
+
+mem_arena *mem_arena_new(size_t size) {
+    char *base = NULL;
+    int mapped = 0;
+    mem_arena *arena;
+
+    size = mem_align(size + sizeof(mem_arena));
+
+#ifdef MEM_ARENA_MMAP
+    // anonymous pages are zero-filled on first access, the reservation itself is almost free
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) base = NULL;
+    mapped = base != NULL;
+#endif
+
+    if (!base) {
+        // large blocks are usually mapped by the allocator as well, calloc skips clearing them then
+        base = calloc(1, size + MEM_CACHELINE);
+        if (!base) return NULL;
+    }
+
+    // the arena header occupies the first cache lines, allocations are aligned relative to it
+    arena = (mem_arena *) mem_align((uintptr_t) base);
+    arena->base = base;
+    arena->size = size;
+    arena->used = mem_align(sizeof(mem_arena));
+    arena->mapped = mapped;
+
+    return arena;
+}
+
+void mem_arena_free(mem_arena *arena) {
+#ifdef MEM_ARENA_MMAP
+    if (arena->mapped) {
+        munmap(arena->base, arena->size);
+        return;
+    }
+#endif
+    free(arena->base);
+}
+
+void *mem_arena_alloc(mem_arena *arena, size_t size) {
+    size_t start = arena->used;
+
+    if (size > arena->size - start) {
+        fprintf(stderr, "mem_arena_alloc: arena exhausted (%" PRI_SIZE_T " of %" PRI_SIZE_T " bytes used, %" PRI_SIZE_T " requested)\n",
+            start, arena->size, size);
+        return NULL;
+    }
+
+    arena->used = min(start + mem_align(size), arena->size);
+
+    return (char *) arena + start;
+}
+
+char *mem_arena_strdup(mem_arena *arena, const char *s) {
+    size_t n = strlen(s) + 1;
+    char *copy = mem_arena_alloc(arena, n);
+
+    if (copy) memcpy(copy, s, n);
+
+    return copy;
+}
+
+int mem_arena_lock(mem_arena *arena) {
+    return mem_lock(arena, arena->used);
+}
+
+
+int mem_lock(void *ptr, size_t bytes) {
+    size_t pagesize = 4096;
+    uintptr_t start, end;
+    volatile char *p;
+
+#ifdef MEM_POSIX
+    if (sysconf(_SC_PAGESIZE) > 0) pagesize = sysconf(_SC_PAGESIZE);
+#endif
+
+    if (bytes == 0) return 0;
+
+    start = (uintptr_t) ptr & ~((uintptr_t) pagesize - 1);
+    end = (uintptr_t) ptr + bytes;
+
+#ifdef MADV_HUGEPAGE
+    // only pages that are faulted in afterwards are allocated as huge pages right away
+    madvise((void *) start, end - start, MADV_HUGEPAGE);
+#endif
+
+#ifdef MEM_POSIX
+    // locking faults in every page
+    if (mlock((void *) start, end - start) == 0) return 1;
+#endif
+
+    // fault the pages in by writing back what they contain
+    for (p = (volatile char *) start; (uintptr_t) p < end; p += pagesize) *p = *p;
+
+    return 0;
+}
+
+size_t mem_lock_limit(void) {
+#ifdef MEM_POSIX
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) return rl.rlim_cur;
+#endif
+    return SIZE_MAX;
+}
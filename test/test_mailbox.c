@@ -0,0 +1,129 @@
+/**
+ * @file test_mailbox.c
+ * @brief checks the hand over of parameter updates through a mailbox: coalescing, lists in progress and clears
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "params.h"
+#include "control/manager.h"
+#include "control/mailbox.h"
+
+
+#define TEST_NUMPARAMS 100 /**< more than fit into one word of a bitmask */
+#define TEST_REQUEST 42
+
+
+static int errors = 0;
+
+static void test_check(int ok, const char *what) {
+    if (!ok && errors++ < 10) printf("    %s\n", what);
+}
+
+/**
+ * @brief a mailbox for a list of parameters that all default to 0
+ */
+static control_mailbox *test_mailbox_new(mem_arena *arena, control_parameter **params) {
+    control_manager *mgr = control_manager_new(arena);
+    char name[16];
+
+    if (!mgr) return NULL;
+
+    for (int id = 0; id < TEST_NUMPARAMS; id++) {
+        snprintf(name, sizeof(name), "p%d", id);
+        params[id] = control_manager_parameter_add(mgr, name, 0.0f, -100.0f, 100.0f);
+        if (!params[id]) return NULL;
+    }
+
+    return control_mailbox_new(arena, TEST_NUMPARAMS);
+}
+
+/**
+ * @brief the last value posted for a parameter wins, and all values of a list apply in the same block
+ */
+static void test_mailbox_coalesce(control_mailbox *mb, control_parameter **params) {
+    int ids[] = {3, 70};
+    float values[] = {2.0f, 5.0f};
+    float value;
+
+    control_mailbox_post(mb, ids, (float[]) {1.0f}, 1);
+    control_mailbox_post(mb, ids, values, 2);
+    test_check(control_mailbox_peek(mb, 3, &value) && value == 2.0f, "coalesce: the last value is pending");
+
+    test_check(control_mailbox_fetch(mb) == CONTROL_MAILBOX_NOREQUEST, "coalesce: no request without a clear");
+    test_check(control_mailbox_apply(mb, params) == 2, "coalesce: two values applied");
+    test_check(params[3]->offset == 2.0f && params[70]->offset == 5.0f, "coalesce: the values are set");
+    test_check(!control_mailbox_peek(mb, 3, &value), "coalesce: nothing pending after the block");
+
+    control_mailbox_fetch(mb);
+    test_check(control_mailbox_apply(mb, params) == 0, "coalesce: values are applied once");
+}
+
+/**
+ * @brief nothing is fetched while a list is being posted, everything applies in the next block
+ */
+static void test_mailbox_in_progress(control_mailbox *mb, control_parameter **params) {
+    int id = 5;
+
+    control_mailbox_post(mb, &id, (float[]) {3.0f}, 1);
+
+    // the sequence is odd while another thread writes a list
+    atomic_fetch_add(&mb->sequence, 1);
+    control_mailbox_fetch(mb);
+    test_check(control_mailbox_apply(mb, params) == 0 && params[5]->offset == 0.0f, "in progress: nothing applied");
+    atomic_fetch_add(&mb->sequence, 1);
+
+    control_mailbox_fetch(mb);
+    test_check(control_mailbox_apply(mb, params) == 1 && params[5]->offset == 3.0f, "in progress: applied in the next block");
+}
+
+/**
+ * @brief a clear drops values and routing changes posted before it and passes its request on,
+ * what is posted after it is applied
+ */
+static void test_mailbox_clear(control_mailbox *mb, control_parameter **params) {
+    control_route before = {.type = CONTROL_ROUTE_AMOUNT, .id = 7, .slot = 0, .amount = 0.5f};
+    control_route after = {.type = CONTROL_ROUTE_AMOUNT, .id = 8, .slot = 1, .amount = 0.75f};
+    int ids[] = {7, 8, 90};
+    float value;
+
+    control_mailbox_post(mb, ids, (float[]) {1.0f, 1.0f, 1.0f}, 3);
+    control_mailbox_route(mb, &before);
+    control_mailbox_clear(mb, TEST_REQUEST - 1);
+    control_mailbox_clear(mb, TEST_REQUEST);
+    control_mailbox_post(mb, ids, (float[]) {4.0f}, 1);
+    control_mailbox_route(mb, &after);
+
+    test_check(!control_mailbox_peek(mb, 90, &value), "clear: values before the clear are not pending");
+    test_check(control_mailbox_fetch(mb) == TEST_REQUEST, "clear: the last request is passed on");
+    test_check(control_mailbox_apply(mb, params) == 2, "clear: one value and one routing change applied");
+    test_check(params[7]->offset == 4.0f, "clear: the value after the clear is set");
+    test_check(params[8]->offset == 0.0f && params[90]->offset == 0.0f, "clear: the values before the clear are dropped");
+    test_check(params[7]->slots[0].amount != 0.5f, "clear: the routing change before the clear is dropped");
+    test_check(params[8]->slots[1].amount == 0.75f, "clear: the routing change after the clear is applied");
+
+    test_check(control_mailbox_fetch(mb) == CONTROL_MAILBOX_NOREQUEST, "clear: the request is passed on once");
+    control_mailbox_apply(mb, params);
+}
+
+int main(void) {
+    mem_arena *arena = mem_arena_new(ARENABASESIZE);
+    control_parameter *params[TEST_NUMPARAMS];
+    control_mailbox *mb = arena ? test_mailbox_new(arena, params) : NULL;
+
+    if (!mb) {
+        fprintf(stderr, "test_mailbox: allocation failed\n");
+        return 1;
+    }
+
+    test_mailbox_coalesce(mb, params);
+    test_mailbox_in_progress(mb, params);
+    test_mailbox_clear(mb, params);
+
+    printf("%-40s %s\n", "mailbox coalescing and clears", errors ? "FAILED" : "ok");
+
+    mem_arena_free(arena);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file test_process.c
+ * @brief checks that goat_process delays the output by exactly one block, however the input is split
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "goat.h"
+
+
+#define TEST_BLOCKSIZE 64
+#define TEST_LENGTH 44100 /**< number of samples rendered */
+#define TEST_SEED 7
+
+
+/**
+ * @brief create an instance whose random modulators give the same sequence every run
+ */
+static goat *test_goat_new(void) {
+    goat_config cfg = {
+        .sample_rate = 44100,
+        .block_size = TEST_BLOCKSIZE
+    };
+    goat *g = goat_new(&cfg);
+
+    if (!g) {
+        fprintf(stderr, "test_goat_new: could not create an instance\n");
+        exit(1);
+    }
+
+    for (int id = 0; id < goat_param_count(g); id++) {
+        const char *name = goat_param_name(g, id);
+        size_t len = strlen(name);
+        if (len > 5 && strcmp(name + len - 5, ".seed") == 0) goat_param_set(g, id, TEST_SEED);
+    }
+    goat_param_set(g, goat_param_id(g, "grainsize"), 0.1f);
+
+    return g;
+}
+
+/**
+ * @brief render the same input block by block and in chunks of odd sizes
+ *
+ * The first half is passed in whole blocks, so the latency would change in the middle of the sound
+ * if goat_process only re-blocked after the first partial block.
+ *
+ * @return int the number of wrong samples
+ */
+static int test_process_latency(void) {
+    static const size_t chunks[] = {1, 37, 64, 100, 5, 250, 63};
+    goat *ref = test_goat_new();
+    goat *g = test_goat_new();
+    float *in = malloc(sizeof(float) * TEST_LENGTH);
+    float *expected = malloc(sizeof(float) * TEST_LENGTH);
+    float *out = malloc(sizeof(float) * TEST_LENGTH);
+    size_t pos, n, c = 0;
+    int errors = 0;
+
+    for (pos = 0; pos < TEST_LENGTH; pos++) in[pos] = sinf(pos * 2 * M_PI * 220 / 44100.0f);
+
+    // whole blocks straight through the engine, without latency
+    memcpy(expected, in, sizeof(float) * TEST_LENGTH);
+    for (pos = 0; pos + TEST_BLOCKSIZE <= TEST_LENGTH; pos += TEST_BLOCKSIZE) {
+        goat_perform(ref, &expected[pos], &expected[pos], TEST_BLOCKSIZE);
+    }
+
+    for (pos = 0; pos < TEST_LENGTH; pos += n) {
+        n = pos < TEST_LENGTH / 2 ? 4 * TEST_BLOCKSIZE : chunks[c++ % (sizeof(chunks) / sizeof(chunks[0]))];
+        if (n > TEST_LENGTH - pos) n = TEST_LENGTH - pos;
+        goat_process(g, &in[pos], &out[pos], n);
+    }
+
+    for (pos = 0; pos < TEST_LENGTH; pos++) {
+        float want = pos < TEST_BLOCKSIZE ? 0.0f : expected[pos - TEST_BLOCKSIZE];
+
+        if (out[pos] != want) {
+            if (errors++ < 5) printf("    sample %zu: %f, expected %f\n", pos, out[pos], want);
+        }
+    }
+
+    free(in);
+    free(expected);
+    free(out);
+    goat_free(ref);
+    goat_free(g);
+
+    return errors;
+}
+
+int main(void) {
+    int errors = test_process_latency();
+
+    printf("%-40s %s\n", "goat_process delays by one block", errors ? "FAILED" : "ok");
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file test_snapshot.c
+ * @brief checks that a snapshot written to a file is read back and recalled into another instance unchanged
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "goat.h"
+
+
+#define TEST_BLOCKSIZE 64
+#define TEST_SLOT 2
+
+
+static goat *test_goat_new(void) {
+    goat_config cfg = {
+        .sample_rate = 44100,
+        .block_size = TEST_BLOCKSIZE
+    };
+    goat *g = goat_new(&cfg);
+
+    if (!g) {
+        fprintf(stderr, "test_goat_new: could not create an instance\n");
+        exit(1);
+    }
+
+    return g;
+}
+
+static void test_goat_block(goat *g) {
+    float in[TEST_BLOCKSIZE] = {0}, out[TEST_BLOCKSIZE];
+    goat_perform(g, in, out, TEST_BLOCKSIZE);
+}
+
+/**
+ * @brief compare the offsets, amounts and modulators of all parameters of two instances
+ *
+ * @return int the number of parameters that differ
+ */
+static int test_compare_params(goat *a, goat *b) {
+    control_parameter *pa, *pb;
+    int errors = 0, differs;
+
+    for (int id = 0; id < goat_param_count(a); id++) {
+        pa = a->params[id];
+        pb = b->params[id];
+
+        differs = pa->offset != pb->offset;
+        for (int s = 0; s < CONTROL_NUM_SLOTS; s++) {
+            differs |= pa->slots[s].amount != pb->slots[s].amount;
+            differs |= (pa->slots[s].mod == NULL) != (pb->slots[s].mod == NULL);
+            differs |= pa->slots[s].mod && pb->slots[s].mod && strcmp(pa->slots[s].mod->name, pb->slots[s].mod->name) != 0;
+        }
+
+        if (differs && errors++ < 5) printf("    %s: %f, expected %f\n", pa->name, pb->offset, pa->offset);
+    }
+
+    return errors;
+}
+
+/**
+ * @brief store a state with values and routing in one instance, write it, read it into another and recall it there
+ *
+ * @return int the number of parameters that differ after the recall
+ */
+static int test_snapshot_file(void) {
+    char path[] = "/tmp/test_snapshot_XXXXXX";
+    goat *a = test_goat_new();
+    goat *b = test_goat_new();
+    int fd, errors;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "test_snapshot_file: could not create a temporary file\n");
+        exit(1);
+    }
+    close(fd);
+
+    goat_param_set(a, goat_param_id(a, "grainsize"), 0.3f);
+    goat_param_set(a, goat_param_id(a, "grainpitch"), -5.0f);
+    goat_param_set(a, goat_param_id(a, "lfo1.frequency"), 3.5f);
+    goat_param_queue_attach(a, goat_param_id(a, "graindelay"), 1, "lfo1");
+    goat_param_queue_amount(a, goat_param_id(a, "graindelay"), 1, 0.25f);
+    test_goat_block(a);
+
+    // the snapshot is taken by the audio thread at the start of the next block
+    goat_snapshot_store(a, TEST_SLOT);
+    test_goat_block(a);
+
+    if (!goat_snapshot_write(a, TEST_SLOT, path)) {
+        fprintf(stderr, "test_snapshot_file: could not write %s\n", path);
+        exit(1);
+    }
+
+    if (goat_snapshot_read(b, TEST_SLOT, path) != 0 || !goat_snapshot_recall(b, TEST_SLOT)) {
+        fprintf(stderr, "test_snapshot_file: could not read %s\n", path);
+        exit(1);
+    }
+    test_goat_block(b);
+
+    errors = test_compare_params(a, b);
+
+    unlink(path);
+    goat_free(a);
+    goat_free(b);
+
+    return errors;
+}
+
+int main(void) {
+    int errors = test_snapshot_file();
+
+    printf("%-40s %s\n", "snapshot file round trip", errors ? "FAILED" : "ok");
+
+    return errors ? 1 : 0;
+}
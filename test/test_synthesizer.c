@@ -0,0 +1,101 @@
+/**
+ * @file test_synthesizer.c
+ * @brief checks that copied voices only read samples the write tap has already written
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "synthesizer/synthesizer.h"
+#include "evelopbuf/evelopbuf.h"
+#include "util/circbuf.h"
+
+
+#define TEST_BUFFERSIZE 4096
+#define TEST_BLOCKSIZE 64
+#define TEST_START 512     /**< position of the first sample of the grain in the delay line */
+#define TEST_WRITTEN 1024  /**< position of the write tap when the grain fires */
+#define TEST_DURATION 200  /**< duration of the grain in samples of the source */
+#define TEST_SPEED 2.0f
+
+
+/**
+ * @brief plays a copied grain faster than the write tap moves
+ *
+ * The delay line is filled with -1 first, then every sample is overwritten with its position + 1.
+ * The grain's playhead stays behind the write tap, so every sample it plays must come from the
+ * second pass, no matter how far the voice reads ahead.
+ *
+ * @return int the number of wrong samples
+ */
+static int test_copy_fast_grain(void) {
+    mem_arena *arena = mem_arena_new(sizeof(float) * 3 * TEST_BUFFERSIZE + ARENABASESIZE);
+    circbuf *cb = arena ? circbuf_new(arena, TEST_BUFFERSIZE, 1, CIRCBUF_FORMAT_FLOAT) : NULL;
+    synthesizer *syn = arena ? synthesizer_new(arena, 1, 1, TEST_BUFFERSIZE) : NULL;
+    evelopbuf *eb = arena ? evelopbuf_new(arena) : NULL;
+    evelope *ep = eb ? evelope_init(&eb->current, eb, 2, TEST_BUFFERSIZE, 1.0f, 64, 64) : NULL;
+    float block[TEST_BLOCKSIZE], out[TEST_BLOCKSIZE];
+    float *env;
+    int length, played = 0, errors = 0;
+    size_t pos = 0;
+    grain gn;
+
+    if (!cb || !syn || !ep) {
+        fprintf(stderr, "test_copy_fast_grain: allocation failed\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < TEST_BLOCKSIZE; i++) block[i] = -1.0f;
+    for (int i = 0; i < TEST_BUFFERSIZE; i += TEST_BLOCKSIZE) circbuf_write_block(cb, block, TEST_BLOCKSIZE);
+
+    while (pos < TEST_WRITTEN - TEST_BLOCKSIZE) {
+        for (int i = 0; i < TEST_BLOCKSIZE; i++) block[i] = (float) (pos++ + 1);
+        circbuf_write_block(cb, block, TEST_BLOCKSIZE);
+    }
+
+    grain_init(&gn, cb, NULL, TEST_WRITTEN, TEST_DURATION, TEST_WRITTEN - TEST_START, TEST_SPEED, TEST_BUFFERSIZE, 2, 0);
+    length = gn.gb_size;
+
+    // the gain of the evelope at every sample of the grain
+    env = malloc(sizeof(float) * length);
+    for (int i = 0; i < length; i++) env[i] = 1.0f;
+    evelope_init(ep, eb, 2, length, 1.0f, 64, 64);
+    evelope_apply(ep, 0, env, length);
+
+    while (played < length) {
+        // like granular_perform: write the input first, then fire and render the grains
+        for (int i = 0; i < TEST_BLOCKSIZE; i++) block[i] = (float) (pos++ + 1);
+        circbuf_write_block(cb, block, TEST_BLOCKSIZE);
+
+        if (played == 0) synthesizer_active_grain(syn, &gn, ep, 0, 0, 0, TEST_BLOCKSIZE);
+        if (played == 0 && syn->numlive != 1) {
+            fprintf(stderr, "test_copy_fast_grain: the grain was not activated\n");
+            exit(1);
+        }
+
+        synthesizer_write_output(syn, out, TEST_BLOCKSIZE);
+
+        for (int i = 0; i < TEST_BLOCKSIZE && played < length; i++, played++) {
+            float expected = env[played] * (TEST_START + TEST_SPEED * played + 1);
+
+            if (fabsf(out[i] - expected) > 1e-3f * fabsf(expected)) {
+                if (errors++ < 5) printf("    sample %d: %f, expected %f\n", played, out[i], expected);
+            }
+        }
+    }
+
+    free(env);
+    circbuf_free(cb);
+    mem_arena_free(arena);
+
+    return errors;
+}
+
+int main(void) {
+    int errors = test_copy_fast_grain();
+
+    printf("%-40s %s\n", "copied grain faster than the write tap", errors ? "FAILED" : "ok");
+
+    return errors ? 1 : 0;
+}
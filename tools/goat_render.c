@@ -0,0 +1,503 @@
+/**
+ * @file goat_render.c
+ * @brief offline batch renderer: processes wav files through a preset as fast as the cpu allows
+ *
+ * Every channel of every input file is rendered by its own goat instance. The channels are
+ * distributed over a pool of threads, a file is written as soon as its last channel is finished.
+ *
+ *     goat-render [-p preset] [-o dir] [-j threads] [-t tail] [-m mix] [-n voices] [-b bits] [-s seed] input.wav...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "goat.h"
+#include "control/preset.h"
+
+
+#define RENDER_CHUNK 4096 /**< number of samples passed to the engine at once, a multiple of every valid block size */
+
+
+typedef struct {
+    const char *inpath;
+    char *outpath;
+
+    int channels;
+    size_t samplerate;
+    size_t frames; /**< number of frames including the tail */
+    size_t inframes; /**< number of frames read from the input */
+    float *data; /**< interleaved samples, rendered in place */
+
+    atomic_int pending; /**< number of channels still to be rendered */
+    double cputime; /**< seconds spent rendering the channels of this file, summed over all threads */
+    int failed;
+} render_file;
+
+typedef struct {
+    render_file *file;
+    int channel;
+} render_job;
+
+typedef struct {
+    const char *presettext;
+    const char *presetpath;
+    int voices;
+    int bits;
+    int seed; /**< seed of the random modulators, 0 for a different result every run */
+    float mix;
+    float tail;
+
+    render_job *jobs;
+    int numjobs;
+    atomic_int nextjob;
+
+    pthread_mutex_t lock; /**< serializes the progress output and the accumulation of cpu times */
+    int numfailed;
+} render_state;
+
+
+static double render_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static uint32_t wav_u32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t wav_u16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+/**
+ * @brief read a wav file as interleaved float samples
+ *
+ * 8, 16, 24 and 32 bit integer and 32 and 64 bit float files are supported.
+ * @a tail seconds of silence are appended.
+ */
+static int wav_read(render_file *rf, float tail) {
+    unsigned char header[12], chunk[8], fmt[40];
+    unsigned char *raw;
+    int format = 0, bits = 0, bytes, fmtfound = 0;
+    uint32_t size;
+    size_t i, n;
+    FILE *f;
+
+    f = fopen(rf->inpath, "rb");
+    if (!f) {
+        fprintf(stderr, "goat-render: could not open %s\n", rf->inpath);
+        return 0;
+    }
+
+    if (fread(header, 1, 12, f) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "goat-render: %s is not a wav file\n", rf->inpath);
+        fclose(f);
+        return 0;
+    }
+
+    // walk the chunks until the samples are found
+    while (fread(chunk, 1, 8, f) == 8) {
+        size = wav_u32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            n = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || fread(fmt, 1, n, f) != n) break;
+            fseek(f, size - n + (size & 1), SEEK_CUR);
+
+            format = wav_u16(fmt);
+            rf->channels = wav_u16(fmt + 2);
+            rf->samplerate = wav_u32(fmt + 4);
+            bits = wav_u16(fmt + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE stores the actual format in the sub format guid
+            if (format == 0xFFFE && n >= 26) format = wav_u16(fmt + 24);
+            fmtfound = 1;
+            continue;
+        }
+
+        if (memcmp(chunk, "data", 4) != 0) {
+            fseek(f, size + (size & 1), SEEK_CUR);
+            continue;
+        }
+
+        if (!fmtfound || rf->channels == 0 || rf->samplerate == 0
+                || !((format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32))
+                    || (format == 3 && (bits == 32 || bits == 64)))) {
+            fprintf(stderr, "goat-render: %s: unsupported sample format (format %d, %d bits)\n", rf->inpath, format, bits);
+            fclose(f);
+            return 0;
+        }
+
+        bytes = bits / 8;
+        rf->inframes = size / (bytes * rf->channels);
+        rf->frames = rf->inframes + (size_t) (tail * rf->samplerate);
+        n = rf->inframes * rf->channels;
+
+        raw = malloc(n * bytes);
+        rf->data = calloc(rf->frames * rf->channels, sizeof(float));
+        if (!raw || !rf->data) {
+            fprintf(stderr, "goat-render: %s: out of memory\n", rf->inpath);
+            free(raw);
+            fclose(f);
+            return 0;
+        }
+
+        // a truncated data chunk is rendered as far as it goes
+        n = fread(raw, bytes, n, f);
+
+        for (i = 0; i < n; i++) {
+            unsigned char *p = raw + i * bytes;
+            switch (format == 3 ? -bits : bits) {
+                case 8: rf->data[i] = (p[0] - 128) / 128.0f; break;
+                case 16: rf->data[i] = (int16_t) wav_u16(p) / 32768.0f; break;
+                case 24: rf->data[i] = (int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24) / 2147483648.0f; break;
+                case 32: rf->data[i] = (int32_t) wav_u32(p) / 2147483648.0f; break;
+                case -32: { uint32_t u = wav_u32(p); float v; memcpy(&v, &u, 4); rf->data[i] = v; } break;
+                case -64: { uint64_t u = wav_u32(p) | ((uint64_t) wav_u32(p + 4) << 32); double v; memcpy(&v, &u, 8); rf->data[i] = (float) v; } break;
+            }
+        }
+
+        free(raw);
+        fclose(f);
+        return 1;
+    }
+
+    fprintf(stderr, "goat-render: %s: no samples found\n", rf->inpath);
+    fclose(f);
+    return 0;
+}
+
+static void wav_put(unsigned char *p, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+/**
+ * @brief write interleaved float samples as a 16 or 24 bit integer or 32 bit float wav file
+ */
+static int wav_write(render_file *rf, int bits) {
+    int bytes = bits / 8;
+    size_t i, n = rf->frames * rf->channels;
+    uint32_t datasize = n * bytes;
+    unsigned char header[44], *raw;
+    FILE *f;
+    float v;
+
+    memcpy(header, "RIFF", 4);
+    wav_put(header + 4, 36 + datasize, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    wav_put(header + 16, 16, 4);
+    wav_put(header + 20, bits == 32 ? 3 : 1, 2);
+    wav_put(header + 22, rf->channels, 2);
+    wav_put(header + 24, rf->samplerate, 4);
+    wav_put(header + 28, rf->samplerate * rf->channels * bytes, 4);
+    wav_put(header + 32, rf->channels * bytes, 2);
+    wav_put(header + 34, bits, 2);
+    memcpy(header + 36, "data", 4);
+    wav_put(header + 40, datasize, 4);
+
+    raw = malloc(datasize);
+    if (!raw) {
+        fprintf(stderr, "goat-render: %s: out of memory\n", rf->outpath);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        v = rf->data[i];
+        if (bits == 32) {
+            memcpy(raw + i * 4, &v, 4);
+            continue;
+        }
+
+        // clip and round to the integer range
+        v = v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+        if (bits == 16) wav_put(raw + i * 2, (uint32_t) (int32_t) (v < 0 ? v * 32768.0f - 0.5f : v * 32767.0f + 0.5f), 2);
+        else wav_put(raw + i * 3, (uint32_t) (int32_t) (v < 0 ? v * 8388608.0f - 0.5f : v * 8388607.0f + 0.5f), 3);
+    }
+
+    f = fopen(rf->outpath, "wb");
+    if (!f || fwrite(header, 1, 44, f) != 44 || fwrite(raw, 1, datasize, f) != datasize) {
+        fprintf(stderr, "goat-render: could not write %s\n", rf->outpath);
+        if (f) fclose(f);
+        free(raw);
+        return 0;
+    }
+
+    fclose(f);
+    free(raw);
+    return 1;
+}
+
+
+/**
+ * @brief render one channel of a file in place with a new goat instance
+ */
+static int render_channel(render_state *st, render_file *rf, int channel) {
+    float buf[RENDER_CHUNK];
+    size_t pos, i, n, padded;
+    int c = rf->channels;
+
+    goat_config cfg = {
+        .sample_rate = rf->samplerate,
+        .block_size = 64,
+        .num_voices = st->voices
+    };
+    goat *g = goat_new(&cfg);
+    if (!g) return 0;
+
+    if (st->presettext) control_preset_apply(g->cfg.mgr, st->presettext, st->presetpath);
+
+    // every channel gets its own sequence, which is the same in every run
+    if (st->seed) {
+        for (int id = 0; id < goat_param_count(g); id++) {
+            const char *name = goat_param_name(g, id);
+            size_t len = strlen(name);
+            if (len > 5 && strcmp(name + len - 5, ".seed") == 0) goat_param_set(g, id, st->seed + channel);
+        }
+    }
+
+    for (pos = 0; pos < rf->frames; pos += n) {
+        n = rf->frames - pos < RENDER_CHUNK ? rf->frames - pos : RENDER_CHUNK;
+
+        // pad the last chunk with silence to whole blocks, which are processed in place without latency
+        padded = (n + g->cfg.block_size - 1) / g->cfg.block_size * g->cfg.block_size;
+
+        for (i = 0; i < n; i++) buf[i] = rf->data[(pos + i) * c + channel];
+        for (; i < padded; i++) buf[i] = 0.0f;
+        for (i = 0; i < padded; i += g->cfg.block_size) goat_perform(g, &buf[i], &buf[i], g->cfg.block_size);
+        for (i = 0; i < n; i++) {
+            float *s = &rf->data[(pos + i) * c + channel];
+            *s = (1.0f - st->mix) * *s + st->mix * buf[i];
+        }
+    }
+
+    goat_free(g);
+    return 1;
+}
+
+static void *render_worker(void *arg) {
+    render_state *st = arg;
+    render_job *job;
+    render_file *rf;
+    double start, elapsed;
+    int j, ok;
+
+    while ((j = atomic_fetch_add(&st->nextjob, 1)) < st->numjobs) {
+        job = &st->jobs[j];
+        rf = job->file;
+
+        start = render_seconds();
+        ok = render_channel(st, rf, job->channel);
+        elapsed = render_seconds() - start;
+
+        pthread_mutex_lock(&st->lock);
+        rf->cputime += elapsed;
+        if (!ok) rf->failed = 1;
+        pthread_mutex_unlock(&st->lock);
+
+        // the last channel to finish writes the file
+        if (atomic_fetch_sub(&rf->pending, 1) != 1) continue;
+
+        ok = !rf->failed && wav_write(rf, st->bits);
+
+        pthread_mutex_lock(&st->lock);
+        if (ok) {
+            printf("%s -> %s: %.2f s of audio in %.2f s cpu time (%.1fx real time per core)\n",
+                rf->inpath, rf->outpath,
+                (double) rf->frames / rf->samplerate, rf->cputime,
+                rf->frames * rf->channels / (rf->samplerate * rf->cputime));
+        } else {
+            fprintf(stderr, "goat-render: rendering %s failed\n", rf->inpath);
+            st->numfailed++;
+        }
+        pthread_mutex_unlock(&st->lock);
+
+        free(rf->data);
+        rf->data = NULL;
+    }
+
+    return NULL;
+}
+
+
+static char *render_outpath(const char *in, const char *dir) {
+    const char *base = strrchr(in, '/') ? strrchr(in, '/') + 1 : in;
+    const char *ext = strrchr(base, '.');
+    size_t stem = ext ? (size_t) (ext - base) : strlen(base);
+    char *out = malloc(strlen(in) + (dir ? strlen(dir) : 0) + 16);
+    if (!out) return NULL;
+
+    // written into the output directory or next to the input, with a suffix in both cases
+    if (dir) sprintf(out, "%s/%.*s_goat.wav", dir, (int) stem, base);
+    else sprintf(out, "%.*s%.*s_goat.wav", (int) (base - in), in, (int) stem, base);
+
+    return out;
+}
+
+/**
+ * @brief check whether two paths name the same existing file
+ */
+static int render_same_file(const char *a, const char *b) {
+    struct stat sa, sb;
+
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0) return 0;
+    return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+static char *render_read_text(const char *path) {
+    FILE *f = fopen(path, "rb");
+    char *text;
+    long size;
+
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    text = size >= 0 ? malloc(size + 1) : NULL;
+    if (text && fread(text, 1, size, f) == (size_t) size) {
+        text[size] = '\0';
+    } else {
+        free(text);
+        text = NULL;
+    }
+
+    fclose(f);
+    return text;
+}
+
+static void render_usage(void) {
+    fprintf(stderr,
+        "usage: goat-render [options] input.wav...\n"
+        "  -p preset   preset file in the format of preset_*.txt\n"
+        "  -o dir      output directory for the <name>_goat.wav files, default: next to the input\n"
+        "  -j threads  number of threads, default: number of cores\n"
+        "  -t seconds  silence appended to let the grains ring out, default 0\n"
+        "  -m mix      dry/wet mix from 0 to 1, default 1 (wet only)\n"
+        "  -n voices   maximum number of simultaneously playing grains\n"
+        "  -b bits     output format: 16, 24 or 32 (float, default)\n"
+        "  -s seed     seed of the random modulators for reproducible renders, default 0 (different every run)\n");
+}
+
+int main(int argc, char **argv) {
+    render_state st = { .bits = 32, .mix = 1.0f };
+    render_file *files;
+    pthread_t *threads;
+    const char *outdir = NULL;
+    int numthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int opt, numfiles, i, c, j;
+    double start, elapsed, audio = 0.0;
+
+    while ((opt = getopt(argc, argv, "p:o:j:t:m:n:b:s:h")) != -1) {
+        switch (opt) {
+            case 'p': st.presetpath = optarg; break;
+            case 'o': outdir = optarg; break;
+            case 'j': numthreads = atoi(optarg); break;
+            case 't': st.tail = atof(optarg); break;
+            case 'm': st.mix = atof(optarg); break;
+            case 'n': st.voices = atoi(optarg); break;
+            case 'b': st.bits = atoi(optarg); break;
+            case 's': st.seed = atoi(optarg); break;
+            default: render_usage(); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    numfiles = argc - optind;
+    if (numfiles <= 0 || numthreads <= 0 || st.tail < 0 || st.seed < 0 || (st.bits != 16 && st.bits != 24 && st.bits != 32)) {
+        render_usage();
+        return 1;
+    }
+
+    // check the preset once up front, so that the instances can apply it silently
+    if (st.presetpath) {
+        st.presettext = render_read_text(st.presetpath);
+        if (!st.presettext) {
+            fprintf(stderr, "goat-render: could not read %s\n", st.presetpath);
+            return 1;
+        }
+
+        goat_config cfg = { 0 };
+        goat *g = goat_new(&cfg);
+        if (!g) return 1;
+        i = control_preset_apply(g->cfg.mgr, st.presettext, st.presetpath);
+        goat_free(g);
+
+        if (i > 0) {
+            fprintf(stderr, "goat-render: %s contains %d invalid messages\n", st.presetpath, i);
+            return 1;
+        }
+    }
+
+    files = calloc(numfiles, sizeof(render_file));
+    if (!files) return 1;
+
+    start = render_seconds();
+
+    for (i = 0; i < numfiles; i++) {
+        files[i].inpath = argv[optind + i];
+        files[i].outpath = render_outpath(files[i].inpath, outdir);
+        if (!files[i].outpath) return 1;
+    }
+
+    // an output must neither replace an input nor another output
+    for (i = 0; i < numfiles; i++) {
+        for (j = 0; j < numfiles; j++) {
+            if (render_same_file(files[i].outpath, files[j].inpath)) {
+                fprintf(stderr, "goat-render: %s would overwrite the input %s\n", files[i].outpath, files[j].inpath);
+                return 1;
+            }
+            if (j < i && (strcmp(files[i].outpath, files[j].outpath) == 0 || render_same_file(files[i].outpath, files[j].outpath))) {
+                fprintf(stderr, "goat-render: %s and %s are both written to %s\n", files[j].inpath, files[i].inpath, files[i].outpath);
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < numfiles; i++) {
+        if (!wav_read(&files[i], st.tail)) return 1;
+
+        atomic_init(&files[i].pending, files[i].channels);
+        st.numjobs += files[i].channels;
+        audio += (double) files[i].frames / files[i].samplerate;
+    }
+
+    st.jobs = malloc(sizeof(render_job) * st.numjobs);
+    threads = malloc(sizeof(pthread_t) * numthreads);
+    if (!st.jobs || !threads) return 1;
+
+    for (i = 0, j = 0; i < numfiles; i++) {
+        for (c = 0; c < files[i].channels; c++) {
+            st.jobs[j].file = &files[i];
+            st.jobs[j].channel = c;
+            j++;
+        }
+    }
+
+    atomic_init(&st.nextjob, 0);
+    pthread_mutex_init(&st.lock, NULL);
+
+    if (numthreads > st.numjobs) numthreads = st.numjobs;
+    for (i = 0; i < numthreads; i++) pthread_create(&threads[i], NULL, render_worker, &st);
+    for (i = 0; i < numthreads; i++) pthread_join(threads[i], NULL);
+
+    elapsed = render_seconds() - start;
+    printf("rendered %.2f s of audio in %.2f s with %d threads, real-time factor %.1fx\n",
+        audio, elapsed, numthreads, audio / elapsed);
+
+    pthread_mutex_destroy(&st.lock);
+    for (i = 0; i < numfiles; i++) free(files[i].outpath);
+    free(files);
+    free(st.jobs);
+    free(threads);
+    free((char *) st.presettext);
+
+    return st.numfailed > 0;
+}
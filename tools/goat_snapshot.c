@@ -0,0 +1,104 @@
+/**
+ * @file goat_snapshot.c
+ * @brief converts text presets into binary snapshots
+ *
+ * Every preset is applied to a fresh instance after `param-reset`, the resulting state is captured and written
+ * next to the preset as `<name>.goatsnap`, or into the directory given with `-o`:
+ *
+ *     goat-snapshot [-o dir] preset_1.txt...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "goat.h"
+#include "control/preset.h"
+
+
+#define SNAPSHOT_EXTENSION ".goatsnap"
+
+
+/**
+ * @brief the output path of a preset: its name with the snapshot extension, in @a outdir or next to the preset
+ */
+static char *snapshot_outpath(const char *presetpath, const char *outdir) {
+    const char *base = strrchr(presetpath, '/');
+    const char *dot;
+    size_t dirlen, baselen;
+    char *path;
+
+    base = base ? base + 1 : presetpath;
+    dot = strrchr(base, '.');
+    baselen = dot ? (size_t) (dot - base) : strlen(base);
+
+    if (outdir) dirlen = strlen(outdir);
+    else dirlen = (size_t) (base - presetpath);
+
+    path = malloc(dirlen + 1 + baselen + sizeof(SNAPSHOT_EXTENSION));
+    if (!path) return NULL;
+
+    if (outdir) sprintf(path, "%s/%.*s" SNAPSHOT_EXTENSION, outdir, (int) baselen, base);
+    else sprintf(path, "%.*s%.*s" SNAPSHOT_EXTENSION, (int) dirlen, presetpath, (int) baselen, base);
+
+    return path;
+}
+
+static void snapshot_usage(void) {
+    fprintf(stderr,
+        "usage: goat-snapshot [options] preset.txt...\n"
+        "  -o dir      output directory, default: next to the preset as <name>" SNAPSHOT_EXTENSION "\n");
+}
+
+int main(int argc, char **argv) {
+    goat_config cfg = { .sample_rate = 44100 };
+    const char *outdir = NULL;
+    char *outpath;
+    goat *g;
+    int opt, i, errors, failed = 0;
+
+    while ((opt = getopt(argc, argv, "o:h")) != -1) {
+        switch (opt) {
+            case 'o': outdir = optarg; break;
+            default: snapshot_usage(); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind == argc) {
+        snapshot_usage();
+        return 1;
+    }
+
+    g = goat_new(&cfg);
+    if (!g) {
+        fprintf(stderr, "goat-snapshot: could not create an instance\n");
+        return 1;
+    }
+
+    for (i = optind; i < argc; i++) {
+        control_manager_reset(g->cfg.mgr);
+
+        errors = control_preset_load(g->cfg.mgr, argv[i]);
+        if (errors < 0) {
+            failed = 1;
+            continue;
+        }
+        if (errors > 0) fprintf(stderr, "goat-snapshot: %s contains %d invalid messages\n", argv[i], errors);
+
+        outpath = snapshot_outpath(argv[i], outdir);
+        // no audio is processed, so the state can be taken right away instead of with goat_snapshot_store
+        control_snapshot_capture(g->snapshots[0], g->cfg.mgr);
+        if (!outpath || !goat_snapshot_write(g, 0, outpath)) {
+            failed = 1;
+        } else {
+            printf("%s -> %s\n", argv[i], outpath);
+        }
+
+        free(outpath);
+    }
+
+    goat_free(g);
+
+    return failed;
+}